@@ -0,0 +1,183 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: ann_eval.cpp
+Purpose: Builds or loads the approximate nearest-neighbour index of a feature database and
+measures it against exact search. Database objects are used as leave-one-out queries: the
+nearest other object found through the index is compared with the exact one under the scaled
+Euclidean metric, giving recall@1 and the query time for each search beam. The exact VP-tree
+is timed on the same queries for reference.
+*/
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "vision_core.h"
+#include "feature_index.h"
+
+namespace fs = std::filesystem;
+
+// Parses a comma-separated list of positive integers, e.g. "16,32,64".
+std::vector<int> parse_int_list(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty() && std::stoi(item) > 0) {
+            values.push_back(std::stoi(item));
+        }
+    }
+    return values;
+}
+
+// Nearest object other than `self` by exact scaled Euclidean search, or -1.
+int exact_nearest_other(const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs, int self) {
+    double best = std::numeric_limits<double>::max();
+    int best_object = -1;
+    for (int o = 0; o < static_cast<int>(known_objects.size()); ++o) {
+        if (o == self) continue;
+        const double d = compute_scaled_euclidean_distance(known_objects[self], known_objects[o], stdevs);
+        if (d < best) {
+            best = d;
+            best_object = o;
+        }
+    }
+    return best_object;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <feature_file> [queries] [search_beams] [--rebuild]"
+                  << " [--neighbors=N] [--build-beam=N]" << std::endl;
+        std::cerr << "  search_beams: comma-separated beam widths to evaluate (default 16,32,64,128,256)" << std::endl;
+        return -1;
+    }
+
+    try {
+        const std::string feature_file = argv[1];
+        int query_count = 1000;
+        std::vector<int> beams = {16, 32, 64, 128, 256};
+        bool rebuild = false;
+        HnswParameters parameters;
+        for (int i = 2, positional = 0; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--rebuild") {
+                rebuild = true;
+            } else if (arg.rfind("--neighbors=", 0) == 0) {
+                parameters.neighbors = std::stoi(arg.substr(12));
+            } else if (arg.rfind("--build-beam=", 0) == 0) {
+                parameters.buildBeam = std::stoi(arg.substr(13));
+            } else if (positional++ == 0) {
+                query_count = std::stoi(arg);
+            } else {
+                beams = parse_int_list(arg);
+            }
+        }
+
+        std::vector<FeatureVector> known_objects = load_known_objects(feature_file);
+        if (known_objects.size() < 2) {
+            std::cerr << "Error: Need at least two known objects in " << feature_file << std::endl;
+            return -1;
+        }
+        std::vector<double> stdevs = compute_feature_stdevs(known_objects);
+
+        // Reuse the index saved next to the database unless it is missing or stale
+        HnswIndex index(parameters);
+        const std::string index_file = feature_index_path(feature_file);
+        if (rebuild || !fs::exists(index_file) || !index.load(index_file, known_objects)) {
+            std::cout << "Building index over " << known_objects.size() << " objects..." << std::endl;
+            int64 start = cv::getTickCount();
+            if (!index.build(known_objects, stdevs)) {
+                return -1;
+            }
+            std::cout << "Built in " << std::fixed << std::setprecision(2)
+                      << (cv::getTickCount() - start) / cv::getTickFrequency() << " s" << std::endl;
+            if (index.save(index_file)) {
+                std::cout << "Saved " << index_file << std::endl;
+            }
+        } else {
+            std::cout << "Loaded " << index_file << std::endl;
+        }
+        std::cout << index.summary() << std::endl;
+
+        // Leave-one-out queries drawn from the database
+        const int n = static_cast<int>(known_objects.size());
+        std::vector<int> queries(std::min(query_count, n));
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> pick(0, n - 1);
+        for (auto& q : queries) {
+            q = pick(rng);
+        }
+
+        std::vector<int> exact(queries.size());
+        int64 start = cv::getTickCount();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            exact[i] = exact_nearest_other(known_objects, stdevs, queries[i]);
+        }
+        const double exact_us = (cv::getTickCount() - start) * 1e6 / cv::getTickFrequency() / queries.size();
+        std::cout << "Exact search: " << std::fixed << std::setprecision(1) << exact_us << " us/query" << std::endl;
+
+        // The exact VP-tree, for reference: the same queries without any loss of recall
+        VpTree<FeatureMetric> tree(FeatureMetric{DistanceMetric::ScaledEuclidean, stdevs});
+        start = cv::getTickCount();
+        tree.build(known_objects);
+        const double tree_build_s = (cv::getTickCount() - start) / cv::getTickFrequency();
+        int tree_misses = 0;
+        start = cv::getTickCount();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            for (const auto& match : tree.search(known_objects[queries[i]], known_objects, 2)) {
+                if (match.second != queries[i]) {
+                    tree_misses += match.second != exact[i];
+                    break;
+                }
+            }
+        }
+        const double tree_us = (cv::getTickCount() - start) * 1e6 / cv::getTickFrequency() / queries.size();
+        std::cout << tree.summary() << ", built in " << std::setprecision(2) << tree_build_s << " s, "
+                  << std::setprecision(1) << tree_us << " us/query (" << exact_us / std::max(tree_us, 1e-3)
+                  << "x), " << tree_misses << " answers differ from the scan" << std::endl;
+
+        std::cout << std::setw(8) << "beam" << std::setw(12) << "recall@1" << std::setw(14) << "label agree"
+                  << std::setw(12) << "us/query" << std::setw(10) << "speedup" << std::endl;
+        for (int beam : beams) {
+            index.setSearchBeam(beam);
+            std::vector<int> found(queries.size(), -1);
+            start = cv::getTickCount();
+            for (size_t i = 0; i < queries.size(); ++i) {
+                for (int o : index.search(known_objects[queries[i]], 2)) {
+                    if (o != queries[i]) {
+                        found[i] = o;
+                        break;
+                    }
+                }
+            }
+            const double us = (cv::getTickCount() - start) * 1e6 / cv::getTickFrequency() / queries.size();
+
+            // A different object at the same distance as the exact answer counts as a hit
+            int hits = 0, agree = 0;
+            for (size_t i = 0; i < queries.size(); ++i) {
+                if (found[i] < 0) continue;
+                const FeatureVector& query = known_objects[queries[i]];
+                hits += compute_scaled_euclidean_distance(query, known_objects[found[i]], stdevs) <=
+                        compute_scaled_euclidean_distance(query, known_objects[exact[i]], stdevs);
+                agree += known_objects[found[i]].label == known_objects[exact[i]].label;
+            }
+            std::cout << std::setw(8) << beam << std::setw(11) << std::setprecision(2)
+                      << 100.0 * hits / queries.size() << "%" << std::setw(13) << 100.0 * agree / queries.size()
+                      << "%" << std::setw(12) << std::setprecision(1) << us << std::setw(9)
+                      << exact_us / std::max(us, 1e-3) << "x" << std::endl;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
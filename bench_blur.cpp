@@ -0,0 +1,112 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: bench_blur.cpp
+Purpose: Benchmarks the fixed-point 5x5 binomial Gaussian kernels against
+cv::cvtColor + cv::GaussianBlur, at every ISA level the CPU supports, and
+checks that every variant produces exactly the same pixels as OpenCV.
+*/
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include "vision_core.h"
+#include "vision_kernels.h"
+
+// Runs fn the given number of times and returns the mean time per call in milliseconds.
+double time_ms(int iterations, const std::function<void()>& fn) {
+    fn();  // warm-up
+    int64 start = cv::getTickCount();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    return (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency() / iterations;
+}
+
+// Single-threaded gray + blur of a whole frame with one specific kernel table.
+void blur_with_kernels(const VisionKernels& kernels, const cv::Mat& bgr, cv::Mat& blurred) {
+    const int rows = bgr.rows;
+    const int cols = bgr.cols;
+    blurred.create(rows, cols, CV_8UC1);
+    std::vector<uchar> gray(cols);
+    std::vector<std::uint16_t> hsum(static_cast<size_t>(rows) * cols);
+
+    for (int y = 0; y < rows; ++y) {
+        kernels.bgr_to_gray_row(bgr.ptr<uchar>(y), gray.data(), cols);
+        kernels.gaussian5_row_h(gray.data(), &hsum[static_cast<size_t>(y) * cols], cols);
+    }
+    for (int y = 0; y < rows; ++y) {
+        const std::uint16_t* taps[5];
+        for (int k = 0; k < 5; ++k) {
+            // cv::BORDER_REFLECT_101 on the row index
+            int r = rows == 1 ? 0 : y + k - 2;
+            while (r < 0 || r >= rows) {
+                r = r < 0 ? -r : 2 * (rows - 1) - r;
+            }
+            taps[k] = &hsum[static_cast<size_t>(r) * cols];
+        }
+        kernels.gaussian5_row_v(taps, blurred.ptr<uchar>(y), cols);
+    }
+}
+
+// Prints one result line: name, time, speedup over OpenCV and whether the output matches.
+void report(const std::string& name, double ms, double baseline_ms, const cv::Mat& result, const cv::Mat& reference) {
+    cv::Mat diff;
+    cv::absdiff(result, reference, diff);
+    int mismatches = cv::countNonZero(diff);
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << ms << " ms" << std::setprecision(2) << std::setw(8) << baseline_ms / ms << "x"
+              << (mismatches == 0 ? "   exact" : "   MISMATCH (" + std::to_string(mismatches) + " px)") << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <image_path | WIDTHxHEIGHT> [iterations]" << std::endl;
+        return -1;
+    }
+
+    std::string source = argv[1];
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 50;
+
+    cv::Mat frame;
+    size_t x_pos = source.find('x');
+    if (x_pos != std::string::npos && source.find_first_not_of("0123456789x") == std::string::npos) {
+        frame.create(std::stoi(source.substr(x_pos + 1)), std::stoi(source.substr(0, x_pos)), CV_8UC3);
+        cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(256));
+    } else {
+        frame = cv::imread(source, cv::IMREAD_COLOR);
+    }
+    if (frame.empty()) {
+        std::cerr << "Error: Could not load " << source << std::endl;
+        return -1;
+    }
+
+    std::cout << "Frame " << frame.cols << "x" << frame.rows << ", " << iterations << " iterations, "
+              << "dispatched ISA " << cpu_isa_name(vision_kernels().isa) << std::endl;
+
+    cv::Mat gray, reference;
+    cv::setNumThreads(1);
+    double opencv_ms = time_ms(iterations, [&]() {
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+        cv::GaussianBlur(gray, reference, cv::Size(5, 5), 0);
+    });
+    report("opencv (1 thread)", opencv_ms, opencv_ms, reference, reference);
+
+    const CpuIsa levels[] = {CpuIsa::Scalar, CpuIsa::SSE42, CpuIsa::AVX2, CpuIsa::AVX512};
+    for (CpuIsa isa : levels) {
+        const VisionKernels& kernels = vision_kernels_for(isa);
+        if (kernels.isa != isa) continue;  // not supported by this CPU
+        cv::Mat blurred;
+        double ms = time_ms(iterations, [&]() { blur_with_kernels(kernels, frame, blurred); });
+        report(std::string("binomial5 ") + cpu_isa_name(isa) + " (1 thread)", ms, opencv_ms, blurred, reference);
+    }
+
+    cv::setNumThreads(-1);
+    cv::Mat banded;
+    double banded_ms = time_ms(iterations, [&]() { banded = gaussian_blur5(frame); });
+    report("gaussian_blur5 (bands)", banded_ms, opencv_ms, banded, reference);
+    return 0;
+}
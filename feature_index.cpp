@@ -0,0 +1,544 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: feature_index.cpp
+Purpose: Implements the indexes declared in feature_index.h: the HNSW graph with its layered
+construction, neighbor selection heuristic, greedy and beam search and binary index file, and
+the LAESA pivot index with its pivot selection and triangle-inequality pruning.
+*/
+
+#include "feature_index.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <sstream>
+
+namespace {
+
+constexpr char kIndexMagic[8] = {'H', 'N', 'S', 'W', 'I', 'D', 'X', '1'};
+
+// Largest number of upper-layer links per node; keeps the link arrays' sizes well inside int.
+constexpr int kMaxNeighbors = 1024;
+
+// FNV-1a hash of the labels and feature values, so a saved index is not used with a database
+// that changed since it was built.
+std::uint64_t database_fingerprint(const std::vector<FeatureVector>& known_objects) {
+    std::uint64_t hash = 1469598103934665603ull;
+    auto add = [&hash](const void* data, size_t bytes) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < bytes; ++i) {
+            hash = (hash ^ p[i]) * 1099511628211ull;
+        }
+    };
+    for (const auto& fv : known_objects) {
+        add(fv.label.data(), fv.label.size() + 1);
+        add(fv.values.data(), fv.values.size() * sizeof(double));
+    }
+    return hash;
+}
+
+template <typename T>
+void write_values(std::ofstream& file, const T* values, size_t n) {
+    file.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(n * sizeof(T)));
+}
+
+template <typename T>
+bool read_values(std::ifstream& file, T* values, size_t n) {
+    file.read(reinterpret_cast<char*>(values), static_cast<std::streamsize>(n * sizeof(T)));
+    return static_cast<bool>(file);
+}
+
+}  // namespace
+
+int* HnswIndex::links(int object, int layer) {
+    return const_cast<int*>(static_cast<const HnswIndex*>(this)->links(object, layer));
+}
+
+const int* HnswIndex::links(int object, int layer) const {
+    if (layer == 0) {
+        return baseLinks.data() + static_cast<size_t>(object) * (capacity(0) + 1);
+    }
+    return upperLinks.data() + upperOffsets[object] + static_cast<size_t>(layer - 1) * (capacity(1) + 1);
+}
+
+// Squared Euclidean distance; only the order matters to the search.
+float HnswIndex::distance(const float* a, const float* b) const {
+    float sum = 0.0f;
+    for (int k = 0; k < dimension; ++k) {
+        const float d = a[k] - b[k];
+        sum += d * d;
+    }
+    return sum;
+}
+
+void HnswIndex::loadPoints(const std::vector<FeatureVector>& known_objects) {
+    points.resize(static_cast<size_t>(count) * dimension);
+    for (int o = 0; o < count; ++o) {
+        float* row = points.data() + static_cast<size_t>(o) * dimension;
+        for (int k = 0; k < dimension; ++k) {
+            row[k] = static_cast<float>(known_objects[o].values[k]) * scale[k];
+        }
+    }
+}
+
+// Sizes the link arrays for the assigned levels, with every list empty.
+void HnswIndex::allocateLinks() {
+    baseLinks.assign(static_cast<size_t>(count) * (capacity(0) + 1), 0);
+    upperOffsets.resize(count);
+    std::int64_t offset = 0;
+    for (int o = 0; o < count; ++o) {
+        upperOffsets[o] = offset;
+        offset += static_cast<std::int64_t>(levels[o]) * (capacity(1) + 1);
+    }
+    upperLinks.assign(static_cast<size_t>(offset), 0);
+    visitedMarks.assign(count, 0);
+    visitedEpoch = 0;
+}
+
+// Checks a loaded graph before it is searched: the entry point must be an object on the top
+// layer, no link list may hold more than its capacity, and every link on a layer must lead to
+// an object that lives on that layer.
+bool HnswIndex::validGraph() const {
+    if (entry < 0 || entry >= count || topLayer != levels[entry]) {
+        return false;
+    }
+    for (int o = 0; o < count; ++o) {
+        if (levels[o] > topLayer) {
+            return false;
+        }
+        for (int layer = 0; layer <= levels[o]; ++layer) {
+            const int* list = links(o, layer);
+            if (list[0] < 0 || list[0] > capacity(layer)) {
+                return false;
+            }
+            for (int i = 1; i <= list[0]; ++i) {
+                if (list[i] < 0 || list[i] >= count || levels[list[i]] < layer) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int HnswIndex::greedyClosest(const float* query, int start, int layer) const {
+    int current = start;
+    float best = distance(query, point(current));
+    for (bool moved = true; moved;) {
+        moved = false;
+        const int* list = links(current, layer);
+        for (int i = 1; i <= list[0]; ++i) {
+            const float d = distance(query, point(list[i]));
+            if (d < best) {
+                best = d;
+                current = list[i];
+                moved = true;
+            }
+        }
+    }
+    return current;
+}
+
+// Beam search on one layer: expands the closest unexpanded candidate until none is closer
+// than the farthest of the `beam` best found. Leaves those best in `nearest`, nearest first.
+void HnswIndex::searchLayer(const float* query, int start, int layer, int beam,
+                            std::vector<std::pair<float, int>>& nearest) const {
+    if (++visitedEpoch == 0) {
+        std::fill(visitedMarks.begin(), visitedMarks.end(), 0u);
+        visitedEpoch = 1;
+    }
+    using Candidate = std::pair<float, int>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> frontier;
+    std::priority_queue<Candidate> best;
+
+    const float d0 = distance(query, point(start));
+    visitedMarks[start] = visitedEpoch;
+    frontier.emplace(d0, start);
+    best.emplace(d0, start);
+    while (!frontier.empty()) {
+        const Candidate current = frontier.top();
+        if (current.first > best.top().first && static_cast<int>(best.size()) >= beam) {
+            break;
+        }
+        frontier.pop();
+        const int* list = links(current.second, layer);
+        for (int i = 1; i <= list[0]; ++i) {
+            const int next = list[i];
+            if (visitedMarks[next] == visitedEpoch) continue;
+            visitedMarks[next] = visitedEpoch;
+            const float d = distance(query, point(next));
+            if (static_cast<int>(best.size()) < beam || d < best.top().first) {
+                frontier.emplace(d, next);
+                best.emplace(d, next);
+                if (static_cast<int>(best.size()) > beam) {
+                    best.pop();
+                }
+            }
+        }
+    }
+
+    nearest.resize(best.size());
+    for (size_t i = nearest.size(); i-- > 0;) {
+        nearest[i] = best.top();
+        best.pop();
+    }
+}
+
+// Keeps up to `limit` of the candidates, nearest first, skipping any that is closer to an
+// already kept one than to the base object. This spreads the links over directions instead
+// of spending them all inside one cluster, which keeps clustered databases navigable.
+void HnswIndex::selectNeighbors(std::vector<std::pair<float, int>>& candidates, int limit) const {
+    std::vector<std::pair<float, int>> kept;
+    for (const auto& candidate : candidates) {
+        if (static_cast<int>(kept.size()) >= limit) break;
+        bool diverse = true;
+        for (const auto& other : kept) {
+            if (distance(point(candidate.second), point(other.second)) < candidate.first) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) {
+            kept.push_back(candidate);
+        }
+    }
+    candidates.swap(kept);
+}
+
+void HnswIndex::insert(int object) {
+    const float* query = point(object);
+    const int level = levels[object];
+    if (entry < 0) {
+        entry = object;
+        topLayer = level;
+        return;
+    }
+
+    int start = entry;
+    for (int layer = topLayer; layer > level; --layer) {
+        start = greedyClosest(query, start, layer);
+    }
+
+    std::vector<std::pair<float, int>> nearest, pool;
+    for (int layer = std::min(level, topLayer); layer >= 0; --layer) {
+        searchLayer(query, start, layer, parameters.buildBeam, nearest);
+        start = nearest[0].second;
+        selectNeighbors(nearest, parameters.neighbors);
+
+        int* own = links(object, layer);
+        own[0] = static_cast<int>(nearest.size());
+        for (size_t i = 0; i < nearest.size(); ++i) {
+            own[i + 1] = nearest[i].second;
+        }
+
+        // Link back; a full list is reselected with the new object among the candidates
+        for (const auto& neighbor : nearest) {
+            int* theirs = links(neighbor.second, layer);
+            if (theirs[0] < capacity(layer)) {
+                theirs[++theirs[0]] = object;
+                continue;
+            }
+            pool.assign(1, {neighbor.first, object});
+            for (int i = 1; i <= theirs[0]; ++i) {
+                pool.emplace_back(distance(point(neighbor.second), point(theirs[i])), theirs[i]);
+            }
+            std::sort(pool.begin(), pool.end());
+            selectNeighbors(pool, capacity(layer));
+            theirs[0] = static_cast<int>(pool.size());
+            for (size_t i = 0; i < pool.size(); ++i) {
+                theirs[i + 1] = pool[i].second;
+            }
+        }
+    }
+
+    if (level > topLayer) {
+        topLayer = level;
+        entry = object;
+    }
+}
+
+bool HnswIndex::build(const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs) {
+    count = 0;
+    entry = topLayer = -1;
+    if (known_objects.empty()) {
+        std::cerr << "Error: Cannot build a feature index over an empty database" << std::endl;
+        return false;
+    }
+    dimension = known_objects[0].dimension();
+    for (const auto& fv : known_objects) {
+        if (fv.dimension() != dimension) {
+            std::cerr << "Error: Cannot build a feature index over a database of mixed dimensions" << std::endl;
+            return false;
+        }
+    }
+    if (static_cast<int>(stdevs.size()) < dimension || parameters.neighbors < 2 ||
+        parameters.neighbors > kMaxNeighbors) {
+        std::cerr << "Error: Invalid feature index parameters" << std::endl;
+        return false;
+    }
+
+    count = static_cast<int>(known_objects.size());
+    scale.resize(dimension);
+    for (int k = 0; k < dimension; ++k) {
+        scale[k] = static_cast<float>(1.0 / stdevs[k]);
+    }
+    loadPoints(known_objects);
+    fingerprint = database_fingerprint(known_objects);
+
+    // Layer l holds each object with probability neighbors^-l
+    std::mt19937 rng(parameters.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const double level_scale = 1.0 / std::log(static_cast<double>(parameters.neighbors));
+    levels.resize(count);
+    for (auto& level : levels) {
+        const double layer = -std::log(1.0 - uniform(rng)) * level_scale;
+        level = static_cast<std::uint8_t>(std::min(layer, 255.0));
+    }
+    allocateLinks();
+
+    for (int o = 0; o < count; ++o) {
+        insert(o);
+    }
+    return true;
+}
+
+bool HnswIndex::save(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+    const std::int32_t header[5] = {dimension, count, parameters.neighbors, entry, topLayer};
+    const std::int64_t upper_size = static_cast<std::int64_t>(upperLinks.size());
+    write_values(file, kIndexMagic, sizeof(kIndexMagic));
+    write_values(file, header, 5);
+    write_values(file, &fingerprint, 1);
+    write_values(file, scale.data(), scale.size());
+    write_values(file, levels.data(), levels.size());
+    write_values(file, baseLinks.data(), baseLinks.size());
+    write_values(file, &upper_size, 1);
+    write_values(file, upperLinks.data(), upperLinks.size());
+    if (!file) {
+        std::cerr << "Error: Could not write feature index " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool HnswIndex::load(const std::string& filename, const std::vector<FeatureVector>& known_objects) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+    char magic[sizeof(kIndexMagic)];
+    std::int32_t header[5];
+    std::uint64_t saved_fingerprint;
+    if (!read_values(file, magic, sizeof(magic)) || std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+        !read_values(file, header, 5) || !read_values(file, &saved_fingerprint, 1) || header[0] <= 0 ||
+        header[2] < 2 || header[2] > kMaxNeighbors) {
+        std::cerr << "Error: " << filename << " is not a feature index" << std::endl;
+        return false;
+    }
+    if (header[1] != static_cast<std::int32_t>(known_objects.size()) ||
+        saved_fingerprint != database_fingerprint(known_objects)) {
+        std::cerr << "Error: " << filename << " was built for a different feature database; rebuild it" << std::endl;
+        return false;
+    }
+    // loadPoints reads `dimension` values of every object
+    for (const auto& known : known_objects) {
+        if (known.dimension() != header[0]) {
+            std::cerr << "Error: " << filename << " is not a feature index" << std::endl;
+            return false;
+        }
+    }
+
+    dimension = header[0];
+    count = header[1];
+    parameters.neighbors = header[2];
+    entry = header[3];
+    topLayer = header[4];
+    fingerprint = saved_fingerprint;
+    scale.resize(dimension);
+    levels.resize(count);
+    std::int64_t upper_size = 0;
+    bool ok = read_values(file, scale.data(), scale.size()) && read_values(file, levels.data(), levels.size());
+    if (ok) {
+        allocateLinks();
+        ok = read_values(file, baseLinks.data(), baseLinks.size()) && read_values(file, &upper_size, 1) &&
+             upper_size == static_cast<std::int64_t>(upperLinks.size()) &&
+             read_values(file, upperLinks.data(), upperLinks.size());
+    }
+    if (!ok) {
+        std::cerr << "Error: Feature index " << filename << " is truncated" << std::endl;
+        count = 0;
+        entry = topLayer = -1;
+        return false;
+    }
+    if (!validGraph()) {
+        std::cerr << "Error: " << filename << " is not a feature index" << std::endl;
+        count = 0;
+        entry = topLayer = -1;
+        return false;
+    }
+    loadPoints(known_objects);
+    return true;
+}
+
+std::vector<int> HnswIndex::search(const FeatureVector& fv, int k) const {
+    std::vector<int> result;
+    if (count == 0 || k <= 0) {
+        return result;
+    }
+    std::vector<float> query(dimension, 0.0f);
+    for (int j = 0; j < std::min(dimension, fv.dimension()); ++j) {
+        query[j] = static_cast<float>(fv.values[j]) * scale[j];
+    }
+
+    int start = entry;
+    for (int layer = topLayer; layer > 0; --layer) {
+        start = greedyClosest(query.data(), start, layer);
+    }
+    std::vector<std::pair<float, int>> nearest;
+    searchLayer(query.data(), start, 0, std::max(parameters.searchBeam, k), nearest);
+    for (int i = 0; i < std::min(k, static_cast<int>(nearest.size())); ++i) {
+        result.push_back(nearest[i].second);
+    }
+    return result;
+}
+
+int HnswIndex::nearest(const FeatureVector& fv) const {
+    const std::vector<int> result = search(fv, 1);
+    return result.empty() ? -1 : result[0];
+}
+
+std::string HnswIndex::summary() const {
+    std::ostringstream out;
+    out << "HNSW index: " << count << " objects, " << topLayer + 1 << " layers, " << parameters.neighbors
+        << " neighbors, search beam " << parameters.searchBeam;
+    return out.str();
+}
+
+bool PivotIndex::build(const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs) {
+    count = static_cast<int>(known_objects.size());
+    pivots.clear();
+    pivotFlags.assign(count, 0);
+    if (count == 0) {
+        std::cerr << "Error: Cannot build a pivot index over an empty database" << std::endl;
+        return false;
+    }
+    this->stdevs = stdevs;
+    const int p_count = std::max(1, std::min(pivotCount, count));
+    pivotDistances.assign(static_cast<size_t>(count) * p_count, 0.0);
+
+    // The first object's farthest neighbour starts the pivots
+    int next = 0;
+    double farthest = -1.0;
+    for (int o = 0; o < count; ++o) {
+        const double d = compute_feature_distance(known_objects[0], known_objects[o], stdevs, metric);
+        if (d > farthest) {
+            farthest = d;
+            next = o;
+        }
+    }
+
+    std::vector<double> sums(count, 0.0);
+    for (int p = 0; p < p_count; ++p) {
+        pivots.push_back(next);
+        pivotFlags[next] = 1;
+        double best = -1.0;
+        for (int o = 0; o < count; ++o) {
+            const double d = compute_feature_distance(known_objects[next], known_objects[o], stdevs, metric);
+            pivotDistances[static_cast<size_t>(o) * p_count + p] = d;
+            sums[o] += d;
+        }
+        for (int o = 0; o < count; ++o) {
+            if (!pivotFlags[o] && sums[o] > best) {
+                best = sums[o];
+                next = o;
+            }
+        }
+    }
+    resetStatistics();
+    return true;
+}
+
+int PivotIndex::nearest(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects) const {
+    if (count == 0 || static_cast<int>(known_objects.size()) != count) {
+        return -1;
+    }
+    searches++;
+
+    // The pivots are objects too, so they also give the first best distance
+    const int p_count = static_cast<int>(pivots.size());
+    std::vector<double> to_pivot(p_count);
+    double best = std::numeric_limits<double>::max();
+    int best_object = -1;
+    for (int p = 0; p < p_count; ++p) {
+        to_pivot[p] = compute_feature_distance(fv, known_objects[pivots[p]], stdevs, metric);
+        if (to_pivot[p] < best || (to_pivot[p] == best && pivots[p] < best_object)) {
+            best = to_pivot[p];
+            best_object = pivots[p];
+        }
+    }
+    distances += p_count;
+
+    // Bounds are compared with a little slack, so rounding never prunes an object that ties
+    for (int o = 0; o < count; ++o) {
+        if (pivotFlags[o]) continue;
+        candidates++;
+        const double* row = pivotDistances.data() + static_cast<size_t>(o) * p_count;
+        const double limit = best + 1e-12 * best;
+        bool skip = false;
+        for (int p = 0; p < p_count; ++p) {
+            if (std::abs(to_pivot[p] - row[p]) > limit) {
+                skip = true;
+                break;
+            }
+        }
+        if (skip) {
+            pruned++;
+            continue;
+        }
+        const double d = compute_feature_distance(fv, known_objects[o], stdevs, metric);
+        distances++;
+        if (d < best || (d == best && o < best_object)) {
+            best = d;
+            best_object = o;
+        }
+    }
+    return best_object;
+}
+
+std::string PivotIndex::summary() const {
+    std::ostringstream out;
+    out << "Pivot index: " << pivots.size() << " pivots over " << count << " objects, pruned " << std::fixed
+        << std::setprecision(1) << 100.0 * getPruneRate() << "% of candidates, "
+        << (searches > 0 ? static_cast<double>(distances) / searches : 0.0) << " distances per search";
+    return out.str();
+}
+
+std::string feature_index_path(const std::string& feature_file) {
+    return feature_file + ".hnsw";
+}
+
+std::string classify_feature_vector(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects,
+                                    const HnswIndex& index) {
+    const int object = index.nearest(fv);
+    if (object < 0 || object >= static_cast<int>(known_objects.size())) {
+        return "Unknown";
+    }
+    return known_objects[object].label;
+}
+
+std::string classify_feature_vector(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects,
+                                    const PivotIndex& index) {
+    const int object = index.nearest(fv, known_objects);
+    return object < 0 ? "Unknown" : known_objects[object].label;
+}
@@ -0,0 +1,347 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: feature_index.h
+Purpose: Nearest-neighbour indexes for feature databases too large for the linear scan in
+classify_feature_vector. HnswIndex is an approximate hierarchical navigable small world graph
+over the features divided by their standard deviations, the space of the scaled Euclidean
+metric; it is saved next to the feature file and checked against it on load. PivotIndex is
+exact for every classifier metric and skips objects by the triangle inequality (LAESA).
+VpTree is an exact vantage-point tree over any distance policy, stored as one flat array.
+*/
+
+#ifndef FEATURE_INDEX_H
+#define FEATURE_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "vision_core.h"
+
+// Graph and search parameters. More neighbors and wider beams raise recall and cost time.
+struct HnswParameters {
+    int neighbors = 16;    // Links per node on the upper layers (2..1024); the bottom layer keeps twice as many
+    int buildBeam = 200;   // Candidates kept while linking a new node
+    int searchBeam = 64;   // Candidates kept while searching; at least the number of results asked for
+    unsigned seed = 42;    // Seed of the random layer assignment
+};
+
+// HNSW graph over a known objects database. Each object lives on layer 0 and, with
+// probability 1/neighbors per layer, on the layers above. A search walks greedily down the
+// sparse upper layers and runs a beam search on layer 0, touching a few thousand objects
+// instead of all of them. Objects are referred to by their position in the database.
+// Searches reuse a visited list kept in the index, so one index serves one thread at a time.
+class HnswIndex {
+private:
+    HnswParameters parameters;
+    int dimension = 0;
+    int count = 0;
+    int entry = -1;
+    int topLayer = -1;
+    std::uint64_t fingerprint = 0;           // Hash of the database the graph was built over
+    std::vector<float> scale;                // 1 / stdev per feature
+    std::vector<float> points;               // Scaled features, dimension apart
+    std::vector<std::uint8_t> levels;        // Top layer of each object
+    std::vector<int> baseLinks;              // Layer 0: per object a count, then 2 * neighbors slots
+    std::vector<std::int64_t> upperOffsets;  // Start of each object's layers 1..level in upperLinks
+    std::vector<int> upperLinks;             // Per object and layer a count, then neighbors slots
+    mutable std::vector<unsigned> visitedMarks;
+    mutable unsigned visitedEpoch = 0;
+
+    const float* point(int object) const { return points.data() + static_cast<size_t>(object) * dimension; }
+    int* links(int object, int layer);
+    const int* links(int object, int layer) const;
+    int capacity(int layer) const { return layer == 0 ? 2 * parameters.neighbors : parameters.neighbors; }
+
+    float distance(const float* a, const float* b) const;
+    void loadPoints(const std::vector<FeatureVector>& known_objects);
+    void allocateLinks();
+    bool validGraph() const;
+    void insert(int object);
+    int greedyClosest(const float* query, int start, int layer) const;
+    void searchLayer(const float* query, int start, int layer, int beam,
+                     std::vector<std::pair<float, int>>& nearest) const;
+    void selectNeighbors(std::vector<std::pair<float, int>>& candidates, int limit) const;
+
+public:
+    explicit HnswIndex(const HnswParameters& parameters = HnswParameters())
+        : parameters(parameters) {}
+
+    // Builds the graph over the database, scaled by the stdevs from compute_feature_stdevs.
+    // Returns false for an empty or mixed-dimension database.
+    bool build(const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs);
+
+    // Writes the graph to a binary file. The features are not stored; they come from the
+    // database again on load.
+    bool save(const std::string& filename) const;
+
+    // Reads a graph written by save. Fails when the database is not the one it was built over.
+    bool load(const std::string& filename, const std::vector<FeatureVector>& known_objects);
+
+    // Database positions of up to k approximately nearest objects, nearest first.
+    std::vector<int> search(const FeatureVector& fv, int k) const;
+
+    // Database position of the approximately nearest object, or -1 for an empty index.
+    int nearest(const FeatureVector& fv) const;
+
+    void setSearchBeam(int beam) { parameters.searchBeam = beam; }
+    int getSearchBeam() const { return parameters.searchBeam; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // One line of index statistics, e.g. "HNSW index: 100000 objects, 5 layers, 16 neighbors, search beam 64".
+    std::string summary() const;
+};
+
+// Exact nearest-neighbour search that prunes with precomputed distances to a few pivot objects
+// (LAESA). For any metric, |d(q, p) - d(o, p)| is a lower bound of d(q, o), so an object
+// whose bound over the pivots already exceeds the best distance found needs no distance
+// computation. The bounds cost one subtraction per pivot, and pivots far from each other and
+// from the rest give tight ones. The answer is the one of classify_feature_vector, ties included.
+// Pruning statistics are kept across searches, so one index serves one thread at a time.
+class PivotIndex {
+private:
+    DistanceMetric metric;
+    int pivotCount;
+    std::vector<double> stdevs;
+    int count = 0;
+    std::vector<int> pivots;                // Database positions of the pivots
+    std::vector<std::uint8_t> pivotFlags;   // 1 for the objects that are pivots
+    std::vector<double> pivotDistances;     // Per object, its distance to each pivot
+    mutable long long searches = 0;
+    mutable long long candidates = 0;       // Objects other than pivots considered by searches
+    mutable long long pruned = 0;           // Candidates skipped by their lower bound
+    mutable long long distances = 0;        // Distance computations, pivots included
+
+public:
+    explicit PivotIndex(DistanceMetric metric = DistanceMetric::ScaledEuclidean, int pivotCount = 16)
+        : metric(metric), pivotCount(pivotCount) {}
+
+    // Picks the pivots and computes every object's distance to them: the first pivot is the
+    // object farthest from the first one, each next the object with the largest sum of
+    // distances to the pivots so far. Costs database size * pivots distances.
+    bool build(const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs);
+
+    // Database position of the nearest object in the database the index was built over, the
+    // first of them on ties, or -1 for an empty index.
+    int nearest(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects) const;
+
+    DistanceMetric getMetric() const { return metric; }
+    int getPivotCount() const { return static_cast<int>(pivots.size()); }
+    long long getSearches() const { return searches; }
+    long long getDistances() const { return distances; }
+    double getPruneRate() const { return candidates > 0 ? static_cast<double>(pruned) / candidates : 0.0; }
+    void resetStatistics() const { searches = candidates = pruned = distances = 0; }
+
+    // One line of pruning statistics, e.g. "Pivot index: 16 pivots over 5000 objects, pruned
+    // 94.1% of candidates, 311.4 distances per search".
+    std::string summary() const;
+};
+
+// Distance policy for VpTree: one of the classifier's metrics, with the stdevs it scales by.
+struct FeatureMetric {
+    DistanceMetric metric = DistanceMetric::ScaledEuclidean;
+    std::vector<double> stdevs;
+
+    double operator()(const FeatureVector& a, const FeatureVector& b) const {
+        return compute_feature_distance(a, b, stdevs, metric);
+    }
+};
+
+// Exact k-nearest-neighbour search for any metric, built once over a known objects database.
+// Distance is any copyable function object taking two FeatureVectors that satisfies the
+// triangle inequality; it is called from several threads during build().
+// Each node holds a vantage object and the median distance from it to the rest of its
+// subtree: closer objects go inside, the others outside. The nodes are stored in preorder
+// in one array, so the inside subtree of node i is [i + 1, outside) and the outside subtree
+// [outside, end of i's subtree), with no pointers. A search visits the side the query falls
+// in first and skips the other when the ball around the query, of the k-th best distance so
+// far, does not reach across the median.
+template <typename Distance = FeatureMetric>
+class VpTree {
+private:
+    struct Node {
+        int object;     // Vantage object, a database position
+        int outside;    // First node of the outside subtree
+        double radius;  // Median distance from the vantage object to the rest of the subtree
+    };
+
+    Distance distance;
+    std::vector<Node> nodes;
+    std::vector<std::pair<double, int>> work;  // Build scratch: distance to the vantage, object
+    mutable long long searches = 0;
+    mutable long long distances = 0;
+
+    // Makes the node at lo: picks its vantage object, splits the rest of [lo, hi) at the median
+    // distance to it, and returns the first node of the outside half.
+    int split(const std::vector<FeatureVector>& known_objects, int lo, int hi) {
+        std::minstd_rand rng(static_cast<unsigned>(lo) + 1u);
+        std::swap(work[lo], work[lo + static_cast<int>(rng() % static_cast<unsigned>(hi - lo))]);
+        const FeatureVector& vantage = known_objects[work[lo].second];
+        for (int i = lo + 1; i < hi; ++i) {
+            work[i].first = distance(vantage, known_objects[work[i].second]);
+        }
+        const int mid = lo + 1 + (hi - lo - 1) / 2;
+        double radius = 0.0;
+        if (mid < hi) {
+            std::nth_element(work.begin() + lo + 1, work.begin() + mid, work.begin() + hi);
+            radius = work[mid].first;
+        }
+        nodes[lo] = {work[lo].second, mid, radius};
+        return mid;
+    }
+
+    void buildRange(const std::vector<FeatureVector>& known_objects, int lo, int hi) {
+        if (hi - lo <= 0) return;
+        const int mid = split(known_objects, lo, hi);
+        buildRange(known_objects, lo + 1, mid);
+        buildRange(known_objects, mid, hi);
+    }
+
+    // Builds the top `levels` levels and collects the subtrees below them.
+    void splitLevels(const std::vector<FeatureVector>& known_objects, int lo, int hi, int levels,
+                     std::vector<std::pair<int, int>>& subtrees) {
+        if (hi - lo <= 0) return;
+        if (levels == 0) {
+            subtrees.emplace_back(lo, hi);
+            return;
+        }
+        const int mid = split(known_objects, lo, hi);
+        splitLevels(known_objects, lo + 1, mid, levels - 1, subtrees);
+        splitLevels(known_objects, mid, hi, levels - 1, subtrees);
+    }
+
+public:
+    explicit VpTree(Distance distance = Distance()) : distance(std::move(distance)) {}
+
+    // Builds the tree over the database. The top levels are split serially until there are a
+    // few subtrees per thread; those are disjoint ranges of the array and are built in parallel.
+    void build(const std::vector<FeatureVector>& known_objects) {
+        const int n = static_cast<int>(known_objects.size());
+        nodes.assign(n, Node{-1, 0, 0.0});
+        work.resize(n);
+        for (int i = 0; i < n; ++i) {
+            work[i] = {0.0, i};
+        }
+        int levels = 0;
+        while ((1 << levels) < 4 * std::max(1, cv::getNumThreads()) && (2 << levels) < n) {
+            levels++;
+        }
+        std::vector<std::pair<int, int>> subtrees;
+        splitLevels(known_objects, 0, n, levels, subtrees);
+        cv::parallel_for_(cv::Range(0, static_cast<int>(subtrees.size())), [&](const cv::Range& range) {
+            for (int t = range.start; t < range.end; ++t) {
+                buildRange(known_objects, subtrees[t].first, subtrees[t].second);
+            }
+        });
+        work.clear();
+        work.shrink_to_fit();
+        searches = distances = 0;
+    }
+
+    // Up to k nearest (distance, database position) pairs, nearest first. Objects at equal
+    // distances come in database order, so k = 1 matches classify_feature_vector.
+    std::vector<std::pair<double, int>> search(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects,
+                                               int k) const {
+        std::vector<std::pair<double, int>> result;
+        if (nodes.empty() || k <= 0 || known_objects.size() != nodes.size()) {
+            return result;
+        }
+        searches++;
+
+        // best is a max-heap of the k best so far; a subtree is skipped when its lower bound
+        // is beyond the k-th distance. The slack keeps rounding from skipping a tie.
+        std::priority_queue<std::pair<double, int>> best;
+        struct Pending {
+            int lo, hi;
+            double bound;  // Lower bound of the distance from the query to the subtree
+        };
+        std::vector<Pending> stack = {{0, static_cast<int>(nodes.size()), 0.0}};
+        while (!stack.empty()) {
+            const Pending range = stack.back();
+            stack.pop_back();
+            if (range.lo >= range.hi) continue;
+            const double limit = static_cast<int>(best.size()) < k ? std::numeric_limits<double>::max()
+                                                                   : best.top().first * (1 + 1e-12);
+            if (range.bound > limit) continue;
+
+            const Node& node = nodes[range.lo];
+            const double d = distance(fv, known_objects[node.object]);
+            distances++;
+            const std::pair<double, int> candidate(d, node.object);
+            if (static_cast<int>(best.size()) < k) {
+                best.push(candidate);
+            } else if (candidate < best.top()) {
+                best.pop();
+                best.push(candidate);
+            }
+
+            // Push the far side first so the near side is searched first
+            const Pending inside = {range.lo + 1, node.outside, std::max(range.bound, d - node.radius)};
+            const Pending outside = {node.outside, range.hi, std::max(range.bound, node.radius - d)};
+            if (d < node.radius) {
+                stack.push_back(outside);
+                stack.push_back(inside);
+            } else {
+                stack.push_back(inside);
+                stack.push_back(outside);
+            }
+        }
+
+        result.resize(best.size());
+        for (size_t i = result.size(); i-- > 0;) {
+            result[i] = best.top();
+            best.pop();
+        }
+        return result;
+    }
+
+    // Database position of the nearest object, or -1 for an empty tree.
+    int nearest(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects) const {
+        const auto result = search(fv, known_objects, 1);
+        return result.empty() ? -1 : result[0].second;
+    }
+
+    int size() const { return static_cast<int>(nodes.size()); }
+    long long getSearches() const { return searches; }
+    long long getDistances() const { return distances; }
+
+    // One line of search statistics, e.g. "VP-tree: 5000 objects, 212.5 distances per search".
+    std::string summary() const {
+        std::ostringstream out;
+        out << "VP-tree: " << nodes.size() << " objects, " << std::fixed << std::setprecision(1)
+            << (searches > 0 ? static_cast<double>(distances) / searches : 0.0) << " distances per search";
+        return out.str();
+    }
+};
+
+// Where the index of a feature file is saved: the file name with ".hnsw" appended.
+std::string feature_index_path(const std::string& feature_file);
+
+// Classifies a feature vector by the approximately nearest known object under the scaled
+// Euclidean metric. Returns "Unknown" for an empty index.
+std::string classify_feature_vector(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects,
+                                    const HnswIndex& index);
+
+// Classifies a feature vector through a pivot index built over known_objects. Same label as
+// classify_feature_vector with the index's metric.
+std::string classify_feature_vector(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects,
+                                    const PivotIndex& index);
+
+// Classifies a feature vector through a VP-tree built over known_objects. Same label as a linear
+// scan under the tree's distance.
+template <typename Distance>
+std::string classify_feature_vector(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects,
+                                    const VpTree<Distance>& tree) {
+    const int object = tree.nearest(fv, known_objects);
+    return object < 0 ? "Unknown" : known_objects[object].label;
+}
+
+#endif // FEATURE_INDEX_H
@@ -0,0 +1,159 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: linescan.cpp
+Purpose: Classifies objects on the endless strip of a line-scan camera. Blocks of lines
+are segmented as they arrive, with enough overlap that the mask matches segmenting the
+whole strip at once, and the mask rows are fed to a streaming labeler that reports each
+object, with its features and classification, as soon as the strip has moved past it.
+*/
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "vision_core.h"
+
+// Segments blocks of strip lines and streams the final mask rows into the labeler.
+// Each segmented buffer starts with `halo` lines that were already emitted, as context,
+// and its last `halo` lines are held back until the lines below them arrive.
+class StripProcessor {
+private:
+    const PipelineOptions& options;
+    const std::vector<FeatureVector>& knownObjects;
+    const std::vector<double>& stdevs;
+    int halo;
+    StreamingLabeler labeler;
+    cv::Mat tail;     // Last lines of the previous buffer
+    int pending = 0;  // Lines at the bottom of tail that have not been emitted yet
+    long long objects = 0;
+
+    // Classifies and prints the regions the labeler closed off.
+    void report(const std::vector<StreamedRegion>& regions) {
+        for (const StreamedRegion& streamed : regions) {
+            std::string label = classify_feature_vector(make_feature_vector(streamed.region), knownObjects,
+                                                        stdevs, DistanceMetric::ScaledEuclidean);
+            std::cout << label << " at x " << streamed.region.boundingBox.x << ", lines " << streamed.firstRow << "-"
+                      << streamed.firstRow + streamed.region.boundingBox.height - 1
+                      << ", area " << streamed.region.area << std::endl;
+            objects++;
+        }
+    }
+
+    // Feeds mask rows [from, to) of a segmented buffer to the labeler.
+    void emitRows(const cv::Mat& cleaned, int from, int to) {
+        for (int y = from; y < to; ++y) {
+            report(labeler.pushRow(cleaned.ptr<uchar>(y)));
+        }
+    }
+
+public:
+    StripProcessor(int width, int minRegionSize, const PipelineOptions& options,
+                   const std::vector<FeatureVector>& knownObjects, const std::vector<double>& stdevs)
+        : options(options), knownObjects(knownObjects), stdevs(stdevs), halo(segmentation_halo(options)),
+          labeler(width, minRegionSize) {}
+
+    // Appends a block of lines to the strip.
+    void push(const cv::Mat& lines) {
+        cv::Mat buffer;
+        if (tail.empty()) {
+            buffer = lines;
+        } else {
+            cv::vconcat(tail, lines, buffer);
+        }
+        cv::Mat cleaned = segment_frame(buffer, options);
+
+        const int context = tail.rows - pending;
+        const int emitted_end = std::max(context, buffer.rows - halo);
+        emitRows(cleaned, context, emitted_end);
+
+        tail = buffer.rowRange(std::max(0, emitted_end - halo), buffer.rows).clone();
+        pending = buffer.rows - emitted_end;
+    }
+
+    // Emits the held-back lines and every object still open at the end of the strip.
+    void finish() {
+        if (pending > 0) {
+            cv::Mat cleaned = segment_frame(tail, options);
+            emitRows(cleaned, tail.rows - pending, tail.rows);
+        }
+        report(labeler.finish());
+        std::cout << "Strip of " << labeler.getRowsSeen() << " lines, " << objects << " objects" << std::endl;
+    }
+};
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " <strip_image | video | camera_index> <lines_per_block> <min_region_size> <feature_file> [options]" << std::endl;
+        std::cerr << pipeline_options_usage();
+        return -1;
+    }
+
+    try {
+        std::string source = argv[1];
+        int lines_per_block = std::stoi(argv[2]);
+        int min_region_size = std::stoi(argv[3]);
+        std::string feature_file = argv[4];
+        if (lines_per_block < 1) {
+            std::cerr << "Error: Lines per block must be at least 1" << std::endl;
+            return -1;
+        }
+
+        PipelineOptions options;
+        if (!parse_pipeline_options(argc, argv, 5, options)) {
+            return -1;
+        }
+
+        std::vector<FeatureVector> known_objects = load_known_objects(feature_file);
+        if (known_objects.empty()) {
+            std::cerr << "Error: No known objects loaded from " << feature_file << std::endl;
+            return -1;
+        }
+        std::vector<double> stdevs = compute_feature_stdevs(known_objects);
+
+        if (options.class_prototypes > 0) {
+            known_objects = class_prototypes(known_objects, stdevs, options.class_prototypes);
+            std::cout << "Classifying against " << known_objects.size() << " class prototypes" << std::endl;
+        }
+
+        // A still image is replayed as a strip, lines_per_block lines at a time. Otherwise every
+        // frame of the video or camera is the next block of lines.
+        cv::Mat strip = cv::imread(source, cv::IMREAD_COLOR);
+        if (!strip.empty()) {
+            StripProcessor processor(strip.cols, min_region_size, options, known_objects, stdevs);
+            for (int y = 0; y < strip.rows; y += lines_per_block) {
+                processor.push(strip.rowRange(y, std::min(strip.rows, y + lines_per_block)));
+            }
+            processor.finish();
+            return 0;
+        }
+
+        cv::VideoCapture capture;
+        if (source.find_first_not_of("0123456789") == std::string::npos) {
+            capture.open(std::stoi(source));
+        } else {
+            capture.open(source);
+        }
+        if (!capture.isOpened()) {
+            std::cerr << "Error: Could not open " << source << std::endl;
+            return -1;
+        }
+
+        cv::Mat lines;
+        if (!capture.read(lines) || lines.empty()) {
+            std::cerr << "Error: No lines read from " << source << std::endl;
+            return -1;
+        }
+        StripProcessor processor(lines.cols, min_region_size, options, known_objects, stdevs);
+        do {
+            processor.push(lines);
+        } while (capture.read(lines) && !lines.empty());
+        processor.finish();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
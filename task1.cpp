@@ -10,30 +10,17 @@ It allows interactive viewing of each thresholded image.
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
 #include <string>
+#include <vector>
+#include "vision_core.h"
 
 namespace fs = std::filesystem;
 
-// Converts input frame to grayscale and applies a manual binary threshold.
-cv::Mat manual_threshold(const cv::Mat& frame, int threshold_value) {
-    cv::Mat gray, thresholded;
-    cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
-    thresholded = cv::Mat::zeros(gray.size(), gray.type());
-
-    for (int i = 0; i < gray.rows; ++i) {
-        for (int j = 0; j < gray.cols; ++j) {
-            if (gray.at<uchar>(i, j) > threshold_value) {
-                thresholded.at<uchar>(i, j) = 255;
-            } else {
-                thresholded.at<uchar>(i, j) = 0;
-            }
-        }
-    }
-    return thresholded;
-}
-
 // Iterates through images in the input directory, applies threshold, and saves the output.
-void process_images(const std::string& input_directory, const std::string& output_directory, int threshold_value) {
+// With an AutoThreshold, threshold_value is ignored and each image gets the automatic threshold.
+void process_images(const std::string& input_directory, const std::string& output_directory, int threshold_value,
+                    AutoThreshold* automatic) {
     // Ensure the output directory exists
     if (!fs::exists(output_directory)) {
         fs::create_directory(output_directory);
@@ -57,7 +44,10 @@ void process_images(const std::string& input_directory, const std::string& outpu
             continue;
         }
 
-        cv::Mat thresholded = manual_threshold(frame, threshold_value);
+        cv::Mat thresholded = automatic ? manual_threshold(frame, *automatic) : manual_threshold(frame, threshold_value);
+        if (automatic) {
+            std::cout << "Threshold: " << automatic->getThreshold() << std::endl;
+        }
         cv::imshow("Thresholded Image", thresholded);
         cv::waitKey(0); // Wait for a key press to move to the next image
 
@@ -69,21 +59,106 @@ void process_images(const std::string& input_directory, const std::string& outpu
     }
 
     cv::destroyAllWindows();
+    if (automatic) {
+        std::cout << automatic->summary() << std::endl;
+    }
+}
+
+// Evaluates every threshold on each image in a single pass instead of one run per value. The
+// region count of each threshold and Otsu's choice go to threshold_sweep.csv in the output
+// directory. The masks of the sample thresholds are saved packed into one image per input, one
+// bit each, so a brighter pixel is foreground in more of them.
+void sweep_images(const std::string& input_directory, const std::string& output_directory, int min_region_size) {
+    if (!fs::exists(output_directory)) {
+        fs::create_directory(output_directory);
+    }
+
+    const std::vector<int> samples = {16, 48, 80, 112, 144, 176, 208, 240};
+    std::ofstream report(output_directory + "/threshold_sweep.csv");
+    if (!report.is_open()) {
+        std::cerr << "Error: Could not open " << output_directory << "/threshold_sweep.csv" << std::endl;
+        return;
+    }
+    report << "image,otsu";
+    for (int t = 0; t < 256; ++t) {
+        report << ",t" << t;
+    }
+    report << "\n";
+
+    std::vector<long> totals(samples.size(), 0);
+    long otsu_sum = 0;
+    int images = 0;
+    for (int i = 1; ; ++i) {
+        std::string image_name = "img" + std::to_string(i) + "p3.png";
+        std::string input_path = input_directory + "/" + image_name;
+        if (!fs::exists(input_path)) {
+            break;
+        }
+
+        cv::Mat frame = cv::imread(input_path);
+        if (frame.empty()) {
+            std::cerr << "Error: Could not read image file " << input_path << std::endl;
+            continue;
+        }
+
+        ThresholdSweep sweep = sweep_thresholds(frame, samples, min_region_size);
+        report << image_name << "," << sweep.otsu;
+        for (int t = 0; t < 256; ++t) {
+            report << "," << sweep.regions[t];
+        }
+        report << "\n";
+
+        std::cout << image_name << ": Otsu " << sweep.otsu << ", regions";
+        for (size_t k = 0; k < samples.size(); ++k) {
+            std::cout << " " << samples[k] << ":" << sweep.regions[samples[k]];
+            totals[k] += sweep.regions[samples[k]];
+        }
+        std::cout << std::endl;
+        otsu_sum += sweep.otsu;
+        images++;
+
+        std::string output_path = output_directory + "/" + image_name;
+        if (!cv::imwrite(output_path, sweep.masks[0])) {
+            std::cerr << "Error: Could not save image to " << output_path << std::endl;
+        }
+    }
+
+    if (images > 0) {
+        std::cout << "Mean Otsu threshold over " << images << " images: " << otsu_sum / images << std::endl;
+        std::cout << "Total regions per threshold:";
+        for (size_t k = 0; k < samples.size(); ++k) {
+            std::cout << " " << samples[k] << ":" << totals[k];
+        }
+        std::cout << std::endl;
+    }
 }
 
 // Validates command-line arguments and initiates image processing if the input path is a directory.
 int main(int argc, char** argv) {
     if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_directory> <threshold_value>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_directory> <threshold_value|auto>" << std::endl;
+        std::cerr << "       " << argv[0] << " <input_directory> <output_directory> sweep [min_region_size]" << std::endl;
         return -1;
     }
 
     std::string input_directory = argv[1];
     std::string output_directory = argv[2];
-    int threshold_value = std::stoi(argv[3]);
+    const bool sweep = std::string(argv[3]) == "sweep";
+
+    if (!fs::is_directory(input_directory)) {
+        std::cerr << "Error: Provided input path is not a directory." << std::endl;
+        return -1;
+    }
+    if (sweep) {
+        sweep_images(input_directory, output_directory, argc > 4 ? std::stoi(argv[4]) : 1);
+        return 0;
+    }
 
+    AutoThreshold automatic;
+    const bool use_auto = std::string(argv[3]) == "auto";
+    int threshold_value = use_auto ? 0 : std::stoi(argv[3]);
     if (fs::is_directory(input_directory)) {
-        process_images(input_directory, output_directory, threshold_value);
+        process_images(input_directory, output_directory, threshold_value, use_auto ? &automatic : nullptr);
     } else {
         std::cerr << "Error: Provided input path is not a directory." << std::endl;
         return -1;
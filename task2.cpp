@@ -10,38 +10,14 @@ displays the results, and saves them to an output directory.
 #include <iostream>
 #include <filesystem>
 #include <string>
+#include "vision_core.h"
 
 namespace fs = std::filesystem;
 
-// Converts the image to grayscale and applies a manual binary threshold.
-cv::Mat manual_threshold(const cv::Mat& frame, int threshold_value) {
-    cv::Mat gray, thresholded;
-    cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
-    thresholded = cv::Mat::zeros(gray.size(), gray.type());
-
-    for (int i = 0; i < gray.rows; ++i) {
-        for (int j = 0; j < gray.cols; ++j) {
-            if (gray.at<uchar>(i, j) > threshold_value) {
-                thresholded.at<uchar>(i, j) = 255;
-            } else {
-                thresholded.at<uchar>(i, j) = 0;
-            }
-        }
-    }
-    return thresholded;
-}
-
-// Cleans noise in the thresholded image using morphological operations.
-cv::Mat clean_image(const cv::Mat& thresholded) {
-    cv::Mat cleaned;
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
-    cv::morphologyEx(thresholded, cleaned, cv::MORPH_CLOSE, kernel);
-    cv::morphologyEx(cleaned, cleaned, cv::MORPH_OPEN, kernel);
-    return cleaned;
-}
-
  // Iterates through images, applies thresholding and cleaning, displays, and saves them.
-void process_images(const std::string& input_directory, const std::string& output_directory, int threshold_value) {
+// With an AutoThreshold, threshold_value is ignored and each image gets the automatic threshold.
+void process_images(const std::string& input_directory, const std::string& output_directory, int threshold_value,
+                    AutoThreshold* automatic) {
     // Ensure the output directory exists
     if (!fs::exists(output_directory)) {
         fs::create_directory(output_directory);
@@ -65,7 +41,10 @@ void process_images(const std::string& input_directory, const std::string& outpu
             continue;
         }
 
-        cv::Mat thresholded = manual_threshold(frame, threshold_value);
+        cv::Mat thresholded = automatic ? manual_threshold(frame, *automatic) : manual_threshold(frame, threshold_value);
+        if (automatic) {
+            std::cout << "Threshold: " << automatic->getThreshold() << std::endl;
+        }
         cv::Mat cleaned = clean_image(thresholded);
         cv::imshow("Thresholded Image", thresholded);
         cv::imshow("Cleaned Image", cleaned);
@@ -79,21 +58,26 @@ void process_images(const std::string& input_directory, const std::string& outpu
     }
 
     cv::destroyAllWindows();
+    if (automatic) {
+        std::cout << automatic->summary() << std::endl;
+    }
 }
 
 // Validates input arguments and initiates image processing if input path is a directory.
 int main(int argc, char** argv) {
     if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_directory> <threshold_value>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_directory> <threshold_value|auto>" << std::endl;
         return -1;
     }
 
     std::string input_directory = argv[1];
     std::string output_directory = argv[2];
-    int threshold_value = std::stoi(argv[3]);
+    AutoThreshold automatic;
+    const bool use_auto = std::string(argv[3]) == "auto";
+    int threshold_value = use_auto ? 0 : std::stoi(argv[3]);
 
     if (fs::is_directory(input_directory)) {
-        process_images(input_directory, output_directory, threshold_value);
+        process_images(input_directory, output_directory, threshold_value, use_auto ? &automatic : nullptr);
     } else {
         std::cerr << "Error: Provided input path is not a directory." << std::endl;
         return -1;
@@ -16,43 +16,22 @@ displayed, and saved to an output directory.
 #include <numeric>
 #include <map>
 #include <vector>
+#include <memory_resource>
 #include <cmath>
+#include "vision_core.h"
 
 namespace fs = std::filesystem;
 
-// Converts the image to grayscale and applies Gaussian blur for noise reduction.
-cv::Mat preprocess_image(const cv::Mat& frame) {
-    cv::Mat gray, blurred;
-    cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
-    cv::GaussianBlur(gray, blurred, cv::Size(5, 5), 0);
-    return blurred;
-}
-
-// Applies adaptive thresholding to create a binary image.
-cv::Mat adaptive_threshold(const cv::Mat& blurred) {
-    cv::Mat thresholded;
-    cv::adaptiveThreshold(blurred, thresholded, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, 
-                         cv::THRESH_BINARY_INV, 11, 2);
-    return thresholded;
-}
-
-// Removes small noise from the binary image using morphological operations.
-cv::Mat clean_image(const cv::Mat& thresholded) {
-    cv::Mat cleaned;
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
-    cv::morphologyEx(thresholded, cleaned, cv::MORPH_CLOSE, kernel);
-    cv::morphologyEx(cleaned, cleaned, cv::MORPH_OPEN, kernel);
-    return cleaned;
-}
-
-// Generates a color-coded map of connected regions based on size constraints.
-cv::Mat create_region_map(const cv::Mat& cleaned, int min_region_size, int max_regions) {
-    cv::Mat labels, stats, centroids;
-    int num_labels = cv::connectedComponentsWithStats(cleaned, labels, stats, centroids);
+// Generates a color-coded map of connected regions based on size constraints. Temporaries
+// come from memory.
+cv::Mat create_region_map(const cv::Mat& cleaned, int min_region_size, int max_regions,
+                          std::pmr::memory_resource* memory) {
+    cv::Mat labels, stats;
+    int num_labels = label_components(cleaned, &labels, stats, memory);
 
     // Create an output image with random colors for each region
     cv::Mat region_map = cv::Mat::zeros(cleaned.size(), CV_8UC3);
-    std::vector<cv::Vec3b> colors(num_labels);
+    std::pmr::vector<cv::Vec3b> colors(num_labels, memory);
     std::mt19937 rng(12345); // Random number generator with a fixed seed for reproducibility
     for (int i = 1; i < num_labels; ++i) {
         if (stats.at<int>(i, cv::CC_STAT_AREA) >= min_region_size) {
@@ -63,7 +42,7 @@ cv::Mat create_region_map(const cv::Mat& cleaned, int min_region_size, int max_r
     }
 
     // Sort regions by size and limit to the largest N regions
-    std::vector<int> sorted_indices(num_labels - 1);
+    std::pmr::vector<int> sorted_indices(num_labels - 1, memory);
     std::iota(sorted_indices.begin(), sorted_indices.end(), 1);
     std::sort(sorted_indices.begin(), sorted_indices.end(), [&stats](int a, int b) {
         return stats.at<int>(a, cv::CC_STAT_AREA) > stats.at<int>(b, cv::CC_STAT_AREA);
@@ -80,7 +59,7 @@ cv::Mat create_region_map(const cv::Mat& cleaned, int min_region_size, int max_r
         if (left > 0 && top > 0 && (left + width) < cleaned.cols && (top + height) < cleaned.rows) {
             for (int y = 0; y < labels.rows; ++y) {
                 for (int x = 0; x < labels.cols; ++x) {
-                    if (labels.at<int>(y, x) == label) {
+                    if (label_at(labels, y, x) == label) {
                         region_map.at<cv::Vec3b>(y, x) = colors[label];
                     }
                 }
@@ -92,12 +71,18 @@ cv::Mat create_region_map(const cv::Mat& cleaned, int min_region_size, int max_r
 }
 
 // Processes each image in the directory by thresholding, cleaning, and mapping regions.
-void process_images(const std::string& input_directory, const std::string& output_directory, int min_region_size, int max_regions) {
+void process_images(const std::string& input_directory, const std::string& output_directory, int min_region_size, int max_regions,
+                    const PipelineOptions& options) {
     // Ensure the output directory exists
     if (!fs::exists(output_directory)) {
         fs::create_directory(output_directory);
     }
 
+    FrameChangeGate gate(options.change_threshold, options.change_tile);
+    BackgroundModel background(options);
+    FrameArena arena;
+    cv::Mat thresholded, cleaned, region_map;
+
     for (int i = 1; ; ++i) {
         std::string image_name = "img" + std::to_string(i) + "p3.png";
         std::string input_path = input_directory + "/" + image_name;
@@ -116,10 +101,19 @@ void process_images(const std::string& input_directory, const std::string& outpu
             continue;
         }
 
-        cv::Mat blurred = preprocess_image(frame);
-        cv::Mat thresholded = adaptive_threshold(blurred);
-        cv::Mat cleaned = clean_image(thresholded);
-        cv::Mat region_map = create_region_map(cleaned, min_region_size, max_regions);
+        if (gate.shouldProcess(frame)) {
+            if (options.threshold_method == ThresholdMethod::Background) {
+                cleaned = background.segment(frame, &thresholded);
+            } else if (options.coarse_to_fine) {
+                cleaned = segment_frame_coarse_to_fine(frame, options, min_region_size, &thresholded);
+            } else {
+                cleaned = segment_frame(frame, options, &thresholded);
+            }
+            region_map = create_region_map(cleaned, min_region_size, max_regions, arena.getResource());
+        } else {
+            std::cout << "Frame unchanged, reusing previous results." << std::endl;
+        }
+        arena.reset();
 
         cv::imshow("Thresholded Image", thresholded);
         cv::imshow("Cleaned Image", cleaned);
@@ -133,13 +127,17 @@ void process_images(const std::string& input_directory, const std::string& outpu
         }
     }
 
+    if (gate.enabled()) {
+        std::cout << gate.summary() << std::endl;
+    }
     cv::destroyAllWindows();
 }
 
 // Validates command-line arguments and initiates processing if input is a directory.
 int main(int argc, char** argv) {
     if (argc < 5) {
-        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_directory> <min_region_size> <max_regions>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_directory> <min_region_size> <max_regions> [options]" << std::endl;
+        std::cerr << pipeline_options_usage();
         return -1;
     }
 
@@ -148,8 +146,13 @@ int main(int argc, char** argv) {
     int min_region_size = std::stoi(argv[3]);
     int max_regions = std::stoi(argv[4]);
 
+    PipelineOptions options;
+    if (!parse_pipeline_options(argc, argv, 5, options)) {
+        return -1;
+    }
+
     if (fs::is_directory(input_directory)) {
-        process_images(input_directory, output_directory, min_region_size, max_regions);
+        process_images(input_directory, output_directory, min_region_size, max_regions, options);
     } else {
         std::cerr << "Error: Provided input path is not a directory." << std::endl;
         return -1;
@@ -20,131 +20,14 @@ to evaluate classification accuracy, helping validate object recognition against
 #include <fstream>
 #include <sstream>
 #include <set>
+#include <iomanip>
+#include "vision_core.h"
+#include "feature_index.h"
 
 namespace fs = std::filesystem;
 
-// Structure to store region information
-struct Region {
-    cv::Point2d centroid;
-    mutable cv::Vec3b color;  // Mutable since it's just for visualization
-    int area;
-    cv::Rect boundingBox;
-    double aspectRatio;
-    bool touchesBoundary;
-    double percentFilled;
-    double leastCentralMomentAxis;
-};
-
-// Structure to store feature vector and label
-struct FeatureVector {
-    std::string label;
-    int area;
-    double aspectRatio;
-    double percentFilled;
-    double leastCentralMomentAxis;
-};
-
-// Function to load the known objects database from a CSV file
-std::vector<FeatureVector> load_known_objects(const std::string& filename) {
-    std::vector<FeatureVector> known_objects;
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file " << filename << std::endl;
-        return known_objects;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        FeatureVector fv;
-        std::getline(ss, fv.label, ',');
-        ss >> fv.area;
-        ss.ignore(1);
-        ss >> fv.aspectRatio;
-        ss.ignore(1);
-        ss >> fv.percentFilled;
-        ss.ignore(1);
-        ss >> fv.leastCentralMomentAxis;
-        known_objects.push_back(fv);
-    }
-
-    file.close();
-    return known_objects;
-}
-
-// Function to compute the scaled Euclidean distance between two feature vectors
-double compute_scaled_euclidean_distance(const FeatureVector& fv1, const FeatureVector& fv2, const std::vector<double>& stdevs) {
-    double distance = 0.0;
-    distance += std::pow((fv1.area - fv2.area) / stdevs[0], 2);
-    distance += std::pow((fv1.aspectRatio - fv2.aspectRatio) / stdevs[1], 2);
-    distance += std::pow((fv1.percentFilled - fv2.percentFilled) / stdevs[2], 2);
-    distance += std::pow((fv1.leastCentralMomentAxis - fv2.leastCentralMomentAxis) / stdevs[3], 2);
-    return std::sqrt(distance);
-}
-
-// Function to compute the simple Euclidean distance between two feature vectors
-double compute_euclidean_distance(const FeatureVector& fv1, const FeatureVector& fv2) {
-    double distance = 0.0;
-    distance += std::pow(fv1.area - fv2.area, 2);
-    distance += std::pow(fv1.aspectRatio - fv2.aspectRatio, 2);
-    distance += std::pow(fv1.percentFilled - fv2.percentFilled, 2);
-    distance += std::pow(fv1.leastCentralMomentAxis - fv2.leastCentralMomentAxis, 2);
-    return std::sqrt(distance);
-}
-
-// Function to compute the standard deviations of the features in the known objects database
-std::vector<double> compute_feature_stdevs(const std::vector<FeatureVector>& known_objects) {
-    std::vector<double> means(4, 0.0);
-    std::vector<double> stdevs(4, 0.0);
-
-    for (const auto& fv : known_objects) {
-        means[0] += fv.area;
-        means[1] += fv.aspectRatio;
-        means[2] += fv.percentFilled;
-        means[3] += fv.leastCentralMomentAxis;
-    }
-
-    for (auto& mean : means) {
-        mean /= known_objects.size();
-    }
-
-    for (const auto& fv : known_objects) {
-        stdevs[0] += std::pow(fv.area - means[0], 2);
-        stdevs[1] += std::pow(fv.aspectRatio - means[1], 2);
-        stdevs[2] += std::pow(fv.percentFilled - means[2], 2);
-        stdevs[3] += std::pow(fv.leastCentralMomentAxis - means[3], 2);
-    }
-
-    for (auto& stdev : stdevs) {
-        stdev = std::sqrt(stdev / known_objects.size());
-    }
-
-    return stdevs;
-}
-
-// Function to classify a new feature vector using the known objects database
-std::string classify_feature_vector(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs, bool use_scaled) {
-    double min_distance = std::numeric_limits<double>::max();
-    std::string best_label;
-
-    for (const auto& known_fv : known_objects) {
-        double distance;
-        if (use_scaled) {
-            distance = compute_scaled_euclidean_distance(fv, known_fv, stdevs);
-        } else {
-            distance = compute_euclidean_distance(fv, known_fv);
-        }
-        if (distance < min_distance) {
-            min_distance = distance;
-            best_label = known_fv.label;
-        }
-    }
-
-    return best_label;
-}
-
-// Function to compute the confusion matrix
-std::map<std::string, std::map<std::string, int>> compute_confusion_matrix(const std::vector<FeatureVector>& test_set, const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs, bool use_scaled) {
+// Function to compute the confusion matrix; with an index, classification goes through it instead of the metric
+std::map<std::string, std::map<std::string, int>> compute_confusion_matrix(const std::vector<FeatureVector>& test_set, const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs, DistanceMetric metric, const HnswIndex* index = nullptr) {
     std::map<std::string, std::map<std::string, int>> confusion_matrix;
     std::set<std::string> labels;
 
@@ -162,7 +45,8 @@ std::map<std::string, std::map<std::string, int>> compute_confusion_matrix(const
 
     // Populate confusion matrix
     for (const auto& test_fv : test_set) {
-        std::string predicted_label = classify_feature_vector(test_fv, known_objects, stdevs, use_scaled);
+        std::string predicted_label = index ? classify_feature_vector(test_fv, known_objects, *index)
+                                            : classify_feature_vector(test_fv, known_objects, stdevs, metric);
         confusion_matrix[test_fv.label][predicted_label]++;
     }
 
@@ -181,9 +65,23 @@ void print_confusion_matrix(const std::map<std::string, std::map<std::string, in
     }
 }
 
+// Function to compute the share of the test set on the diagonal of a confusion matrix, in percent
+double confusion_accuracy(const std::map<std::string, std::map<std::string, int>>& confusion_matrix) {
+    int correct = 0, total = 0;
+    for (const auto& actual_pair : confusion_matrix) {
+        for (const auto& predicted_pair : actual_pair.second) {
+            total += predicted_pair.second;
+            if (predicted_pair.first == actual_pair.first) {
+                correct += predicted_pair.second;
+            }
+        }
+    }
+    return total > 0 ? 100.0 * correct / total : 0.0;
+}
+
 int main(int argc, char** argv) {
     if (argc < 6) {
-        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_directory> <min_region_size> <max_regions> <feature_file>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_directory> <min_region_size> <max_regions> <feature_file> [prototypes_per_class]" << std::endl;
         return -1;
     }
 
@@ -193,6 +91,7 @@ int main(int argc, char** argv) {
         int min_region_size = std::stoi(argv[3]);
         int max_regions = std::stoi(argv[4]);
         std::string feature_file = argv[5];
+        int prototypes_per_class = argc > 6 ? std::stoi(argv[6]) : 3;
 
         if (!fs::is_directory(input_directory)) {
             std::cerr << "Error: Provided input path is not a directory." << std::endl;
@@ -213,8 +112,8 @@ int main(int argc, char** argv) {
         std::vector<FeatureVector> test_set = known_objects;
 
         // Compute confusion matrices
-        auto confusion_matrix_simple = compute_confusion_matrix(test_set, known_objects, stdevs, false);
-        auto confusion_matrix_scaled = compute_confusion_matrix(test_set, known_objects, stdevs, true);
+        auto confusion_matrix_simple = compute_confusion_matrix(test_set, known_objects, stdevs, DistanceMetric::Euclidean);
+        auto confusion_matrix_scaled = compute_confusion_matrix(test_set, known_objects, stdevs, DistanceMetric::ScaledEuclidean);
 
         // Print confusion matrices
         std::cout << "Simple Euclidean Distance:" << std::endl;
@@ -222,6 +121,33 @@ int main(int argc, char** argv) {
 
         std::cout << "Scaled Euclidean Distance:" << std::endl;
         print_confusion_matrix(confusion_matrix_scaled);
+
+        // Approximate search, when ann_eval has saved an index next to the database
+        HnswIndex index;
+        const std::string index_file = feature_index_path(feature_file);
+        if (fs::exists(index_file) && index.load(index_file, known_objects)) {
+            auto confusion_matrix_index = compute_confusion_matrix(test_set, known_objects, stdevs, DistanceMetric::ScaledEuclidean, &index);
+            std::cout << "Scaled Euclidean Distance (" << index.summary() << "):" << std::endl;
+            print_confusion_matrix(confusion_matrix_index);
+        }
+
+        // Condensed databases: the class means, and k-means prototypes per class
+        std::vector<FeatureVector> class_means = class_prototypes(known_objects, stdevs, 1);
+        std::vector<FeatureVector> prototypes = class_prototypes(known_objects, stdevs, std::max(1, prototypes_per_class));
+        auto confusion_matrix_means = compute_confusion_matrix(test_set, class_means, stdevs, DistanceMetric::ScaledEuclidean);
+        auto confusion_matrix_prototypes = compute_confusion_matrix(test_set, prototypes, stdevs, DistanceMetric::ScaledEuclidean);
+
+        std::cout << "Nearest Class Mean (" << class_means.size() << " prototypes):" << std::endl;
+        print_confusion_matrix(confusion_matrix_means);
+
+        std::cout << "Nearest of " << std::max(1, prototypes_per_class) << " Prototypes per Class (" << prototypes.size() << " prototypes):" << std::endl;
+        print_confusion_matrix(confusion_matrix_prototypes);
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Scaled Euclidean accuracy: 1-NN over " << known_objects.size() << " objects "
+                  << confusion_accuracy(confusion_matrix_scaled) << "%, class means "
+                  << confusion_accuracy(confusion_matrix_means) << "%, prototypes "
+                  << confusion_accuracy(confusion_matrix_prototypes) << "%" << std::endl;
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,2869 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: vision_core.cpp
+Purpose: Implements the shared image-processing and classification core declared in
+vision_core.h. These functions used to be copied into every task program; they now
+live here once so that each optimization only has to be made in one place.
+*/
+
+#include "vision_core.h"
+#include "vision_kernels.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <type_traits>
+
+// Rows per band in the tile-parallel mean threshold; each band also blurs a block_size / 2 halo.
+static const int kMinBandRows = 32;
+
+// Rows per band in the fused segmentation pipeline. The per-stage ring buffers are only a
+// few rows tall whatever the band height; taller bands just recompute fewer halo rows.
+static const int kFusedBandRows = 128;
+
+// Pixel stride of the frame-gate thumbnail in both directions; 1/16 of the pixels are compared.
+static const int kGateStride = 4;
+
+// Downscale factor of the coarse-to-fine candidate search, and the margin, in coarse pixels,
+// added around each upscaled candidate box to cover what the downscale blurred away.
+static const int kCoarseScale = 4;
+static const int kCoarseMarginCells = 2;
+
+cv::Vec3b RegionTracker::generateRandomColor() {
+    return cv::Vec3b(rng() % 256, rng() % 256, rng() % 256);
+}
+
+double RegionTracker::calculateDistance(const cv::Point2d& p1, const cv::Point2d& p2) {
+    return std::sqrt(std::pow(p1.x - p2.x, 2) + std::pow(p1.y - p2.y, 2));
+}
+
+cv::Vec3b RegionTracker::getRegionColor(const RegionBatch& regions, size_t i) {
+    double minDistance = std::numeric_limits<double>::max();
+    cv::Vec3b matchedColor;
+    bool found = false;
+    const cv::Point2d centroid(regions.centroidX[i], regions.centroidY[i]);
+
+    for (size_t p = 0; p < previousColors.size(); ++p) {
+        double distance = calculateDistance(centroid, cv::Point2d(previousX[p], previousY[p]));
+        if (distance < minDistance && distance < MAX_CENTROID_DISTANCE) {
+            minDistance = distance;
+            matchedColor = previousColors[p];
+            found = true;
+        }
+    }
+
+    return found ? matchedColor : generateRandomColor();
+}
+
+void RegionTracker::updateRegions(const RegionBatch& regions, const std::pmr::vector<int>& tracked) {
+    previousX.clear();
+    previousY.clear();
+    previousColors.clear();
+    for (int i : tracked) {
+        previousX.push_back(regions.centroidX[i]);
+        previousY.push_back(regions.centroidY[i]);
+        previousColors.push_back(regions.color[i]);
+    }
+}
+
+void RegionBatch::clear() {
+    area.clear();
+    boundingBox.clear();
+    centroidX.clear();
+    centroidY.clear();
+    aspectRatio.clear();
+    percentFilled.clear();
+    leastCentralMomentAxis.clear();
+    touchesBoundary.clear();
+    eulerNumber.clear();
+    holes.clear();
+    perimeter.clear();
+    compactness.clear();
+    for (auto& column : huMoments) {
+        column.clear();
+    }
+    orientedBoundingBox.clear();
+    convexHull.clear();
+    color.clear();
+}
+
+void RegionBatch::reserve(size_t n) {
+    area.reserve(n);
+    boundingBox.reserve(n);
+    centroidX.reserve(n);
+    centroidY.reserve(n);
+    aspectRatio.reserve(n);
+    percentFilled.reserve(n);
+    leastCentralMomentAxis.reserve(n);
+    touchesBoundary.reserve(n);
+    eulerNumber.reserve(n);
+    holes.reserve(n);
+    perimeter.reserve(n);
+    compactness.reserve(n);
+    for (auto& column : huMoments) {
+        column.reserve(n);
+    }
+    orientedBoundingBox.reserve(n);
+    convexHull.reserve(n);
+    color.reserve(n);
+}
+
+void RegionBatch::add(const Region& region) {
+    area.push_back(region.area);
+    boundingBox.push_back(region.boundingBox);
+    centroidX.push_back(static_cast<float>(region.centroid.x));
+    centroidY.push_back(static_cast<float>(region.centroid.y));
+    aspectRatio.push_back(static_cast<float>(region.aspectRatio));
+    percentFilled.push_back(static_cast<float>(region.percentFilled));
+    leastCentralMomentAxis.push_back(static_cast<float>(region.leastCentralMomentAxis));
+    touchesBoundary.push_back(region.touchesBoundary ? 1 : 0);
+    eulerNumber.push_back(region.eulerNumber);
+    holes.push_back(region.holes);
+    perimeter.push_back(region.perimeter);
+    compactness.push_back(static_cast<float>(region.compactness));
+    for (int k = 0; k < 7; ++k) {
+        huMoments[k].push_back(static_cast<float>(region.huMoments[k]));
+    }
+    orientedBoundingBox.push_back(region.orientedBoundingBox);
+    convexHull.push_back(region.convexHull);
+    color.push_back(region.color);
+}
+
+Region RegionBatch::get(size_t i) const {
+    Region region;
+    region.area = area[i];
+    region.boundingBox = boundingBox[i];
+    region.centroid = cv::Point2d(centroidX[i], centroidY[i]);
+    region.aspectRatio = aspectRatio[i];
+    region.percentFilled = percentFilled[i];
+    region.leastCentralMomentAxis = leastCentralMomentAxis[i];
+    region.touchesBoundary = touchesBoundary[i] != 0;
+    region.eulerNumber = eulerNumber[i];
+    region.holes = holes[i];
+    region.perimeter = perimeter[i];
+    region.compactness = compactness[i];
+    for (int k = 0; k < 7; ++k) {
+        region.huMoments[k] = huMoments[k][i];
+    }
+    region.orientedBoundingBox = orientedBoundingBox[i];
+    region.convexHull = convexHull[i];
+    region.color = color[i];
+    return region;
+}
+
+// Reorders values by the permutation order, so that values[k] becomes the old values[order[k]].
+// The values go through a scratch copy and back, so the column keeps its own storage.
+template <typename T>
+static void permute(std::vector<T>& values, const std::pmr::vector<int>& order, std::pmr::memory_resource* memory) {
+    std::pmr::vector<T> sorted(memory);
+    sorted.reserve(order.size());
+    for (int i : order) {
+        sorted.push_back(std::move(values[i]));
+    }
+    std::move(sorted.begin(), sorted.end(), values.begin());
+}
+
+void RegionBatch::sortByAreaDescending(std::pmr::memory_resource* memory) {
+    std::pmr::vector<int> order(size(), memory);
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<int>(i);
+    }
+    // Ties keep their order; stable_sort would take its buffer from the global heap
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return area[a] != area[b] ? area[a] > area[b] : a < b; });
+    permute(area, order, memory);
+    permute(boundingBox, order, memory);
+    permute(centroidX, order, memory);
+    permute(centroidY, order, memory);
+    permute(aspectRatio, order, memory);
+    permute(percentFilled, order, memory);
+    permute(leastCentralMomentAxis, order, memory);
+    permute(touchesBoundary, order, memory);
+    permute(eulerNumber, order, memory);
+    permute(holes, order, memory);
+    permute(perimeter, order, memory);
+    permute(compactness, order, memory);
+    for (auto& column : huMoments) {
+        permute(column, order, memory);
+    }
+    permute(orientedBoundingBox, order, memory);
+    permute(convexHull, order, memory);
+    permute(color, order, memory);
+}
+
+void FrameChangeGate::buildThumbnail(const cv::Mat& frame, std::vector<uchar>& thumbnail) const {
+    const int thumb_cols = (frame.cols + kGateStride - 1) / kGateStride;
+    const int thumb_rows = (frame.rows + kGateStride - 1) / kGateStride;
+    const int channels = frame.channels();
+    thumbnail.resize(static_cast<size_t>(thumb_cols) * thumb_rows);
+
+    for (int ty = 0; ty < thumb_rows; ++ty) {
+        const uchar* src = frame.ptr<uchar>(ty * kGateStride);
+        uchar* dst = &thumbnail[static_cast<size_t>(ty) * thumb_cols];
+        for (int tx = 0; tx < thumb_cols; ++tx) {
+            const uchar* p = src + tx * kGateStride * channels;
+            // (B + 2G + R) / 4 is close enough to luma for change detection
+            dst[tx] = channels == 1 ? p[0] : static_cast<uchar>((p[0] + 2 * p[1] + p[2] + 2) >> 2);
+        }
+    }
+}
+
+bool FrameChangeGate::shouldProcess(const cv::Mat& frame) {
+    framesSeen++;
+    tileCountX = (frame.cols + tileSize - 1) / tileSize;
+    tileCountY = (frame.rows + tileSize - 1) / tileSize;
+    changedTileFlags.assign(static_cast<size_t>(tileCountX) * tileCountY, 1);
+    if (!enabled()) {
+        return true;
+    }
+
+    buildThumbnail(frame, currentThumbnail);
+    if (referenceThumbnail.empty() || frame.size() != frameSize) {
+        frameSize = frame.size();
+        referenceThumbnail.swap(currentThumbnail);
+        return true;
+    }
+
+    // Sum of absolute differences per tile. Thumbnail pixel (tx, ty) samples frame pixel
+    // (tx, ty) * kGateStride, which maps it to a tile for any tile size.
+    const int thumb_cols = (frame.cols + kGateStride - 1) / kGateStride;
+    const int thumb_rows = (frame.rows + kGateStride - 1) / kGateStride;
+    std::vector<std::int64_t> tile_sad(changedTileFlags.size(), 0);
+    std::vector<int> tile_count(changedTileFlags.size(), 0);
+    for (int ty = 0; ty < thumb_rows; ++ty) {
+        const uchar* cur = &currentThumbnail[static_cast<size_t>(ty) * thumb_cols];
+        const uchar* ref = &referenceThumbnail[static_cast<size_t>(ty) * thumb_cols];
+        const int tile_row = (ty * kGateStride) / tileSize * tileCountX;
+        for (int tx = 0; tx < thumb_cols; ++tx) {
+            const int tile = tile_row + (tx * kGateStride) / tileSize;
+            tile_sad[tile] += std::abs(cur[tx] - ref[tx]);
+            tile_count[tile]++;
+        }
+    }
+
+    bool changed = false;
+    for (size_t t = 0; t < changedTileFlags.size(); ++t) {
+        changedTileFlags[t] = tile_count[t] > 0 && tile_sad[t] > threshold * tile_count[t];
+        changed = changed || changedTileFlags[t];
+    }
+
+    if (!changed) {
+        framesSkipped++;
+        return false;
+    }
+
+    // Only changed tiles take the new thumbnail. Slow drift in the other tiles keeps being
+    // measured against the frame they were last processed from until it crosses the threshold.
+    for (int ty = 0; ty < thumb_rows; ++ty) {
+        const int tile_row = (ty * kGateStride) / tileSize * tileCountX;
+        for (int tx = 0; tx < thumb_cols; ++tx) {
+            const size_t i = static_cast<size_t>(ty) * thumb_cols + tx;
+            if (changedTileFlags[tile_row + (tx * kGateStride) / tileSize]) {
+                referenceThumbnail[i] = currentThumbnail[i];
+            }
+        }
+    }
+    return true;
+}
+
+std::string FrameChangeGate::summary() const {
+    std::ostringstream out;
+    double percent = framesSeen > 0 ? 100.0 * framesSkipped / framesSeen : 0.0;
+    out << "Frame gate: skipped " << framesSkipped << " of " << framesSeen << " frames ("
+        << std::fixed << std::setprecision(1) << percent << "%)";
+    return out.str();
+}
+
+void* FrameArena::SpillResource::do_allocate(size_t bytes, size_t alignment) {
+    spilled += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void FrameArena::SpillResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+FrameArena::FrameArena(size_t initialBytes)
+    : buffer(new std::byte[initialBytes]), capacity(initialBytes) {
+    arena.emplace(buffer.get(), capacity, &spill);
+}
+
+void FrameArena::reset() {
+    // Destroying the arena hands its spilled chunks back to the heap
+    arena.reset();
+    frames++;
+    if (spill.spilled > 0) {
+        framesSpilled++;
+        capacity += spill.spilled;
+        buffer.reset(new std::byte[capacity]);
+        spill.spilled = 0;
+    }
+    arena.emplace(buffer.get(), capacity, &spill);
+}
+
+std::string FrameArena::summary() const {
+    std::ostringstream out;
+    out << "Frame arena: " << capacity / 1024 << " KiB, " << framesSpilled << " of " << frames
+        << " frames spilled to the heap";
+    return out.str();
+}
+
+bool AutoThreshold::drifted(const std::array<int, 256>& histogram) const {
+    // Compares the share of pixels in each band of 16 gray levels, so sensor noise that moves
+    // pixels by a level or two does not count as drift.
+    long total = 0;
+    for (int count : histogram) {
+        total += count;
+    }
+    if (total == 0 || referenceTotal == 0) {
+        return false;
+    }
+    double moved = 0;
+    for (int band = 0; band < 256; band += 16) {
+        long current = 0, reference = 0;
+        for (int g = band; g < band + 16; ++g) {
+            current += histogram[g];
+            reference += referenceHistogram[g];
+        }
+        moved += std::abs(static_cast<double>(current) / total - static_cast<double>(reference) / referenceTotal);
+    }
+    return moved / 2 > drift;
+}
+
+int AutoThreshold::update(const std::array<int, 256>& histogram) {
+    framesSeen++;
+    if (threshold >= 0 && ++framesSinceUpdate < interval && !drifted(histogram)) {
+        return threshold;
+    }
+
+    const int otsu = otsu_threshold(histogram);
+    smoothedThreshold = threshold < 0 ? otsu : smoothedThreshold + smoothing * (otsu - smoothedThreshold);
+    threshold = static_cast<int>(std::lround(smoothedThreshold));
+    referenceHistogram = histogram;
+    referenceTotal = 0;
+    for (int count : histogram) {
+        referenceTotal += count;
+    }
+    framesSinceUpdate = 0;
+    updates++;
+    return threshold;
+}
+
+std::string AutoThreshold::summary() const {
+    std::ostringstream out;
+    out << "Auto threshold: " << threshold << ", recomputed on " << updates << " of " << framesSeen << " frames";
+    return out.str();
+}
+
+// Parses the whole of value as a number for the flag key; prints an error and returns false
+// if it is empty, malformed, out of range or followed by anything else.
+template <typename T>
+static bool parse_option_value(const std::string& key, const std::string& value, T& result) {
+    size_t used = 0;
+    T parsed = T();
+    try {
+        if constexpr (std::is_same<T, int>::value) {
+            parsed = std::stoi(value, &used);
+        } else {
+            parsed = std::stod(value, &used);
+        }
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (value.empty() || used != value.size()) {
+        std::cerr << "Error: Invalid value for " << key << ": \"" << value << "\"" << std::endl;
+        return false;
+    }
+    result = parsed;
+    return true;
+}
+
+bool parse_pipeline_options(int argc, char** argv, int first, PipelineOptions& options) {
+    for (int i = first; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (key == "--threshold") {
+            if (value == "gaussian") {
+                options.threshold_method = ThresholdMethod::Gaussian;
+            } else if (value == "mean") {
+                options.threshold_method = ThresholdMethod::Mean;
+            } else if (value == "background") {
+                options.threshold_method = ThresholdMethod::Background;
+            } else {
+                std::cerr << "Error: Unknown threshold method " << value << std::endl;
+                return false;
+            }
+        } else if (key == "--block") {
+            if (!parse_option_value(key, value, options.block_size)) {
+                return false;
+            }
+            if (options.block_size < 3 || options.block_size % 2 == 0) {
+                std::cerr << "Error: Block size must be odd and at least 3" << std::endl;
+                return false;
+            }
+        } else if (key == "--offset") {
+            if (!parse_option_value(key, value, options.threshold_offset)) {
+                return false;
+            }
+        } else if (key == "--skip-static") {
+            if (!parse_option_value(key, value, options.change_threshold)) {
+                return false;
+            }
+        } else if (key == "--gate-tile") {
+            if (!parse_option_value(key, value, options.change_tile)) {
+                return false;
+            }
+            if (options.change_tile < kGateStride) {
+                std::cerr << "Error: Gate tile size must be at least " << kGateStride << std::endl;
+                return false;
+            }
+        } else if (key == "--coarse-to-fine") {
+            options.coarse_to_fine = true;
+        } else if (key == "--bg-update") {
+            if (value == "average") {
+                options.background_update = BackgroundUpdate::Average;
+            } else if (value == "median") {
+                options.background_update = BackgroundUpdate::Median;
+            } else {
+                std::cerr << "Error: Unknown background update " << value << std::endl;
+                return false;
+            }
+        } else if (key == "--bg-rate") {
+            if (!parse_option_value(key, value, options.background_rate)) {
+                return false;
+            }
+            if (options.background_rate <= 0 || options.background_rate >= 1) {
+                std::cerr << "Error: Background rate must be between 0 and 1" << std::endl;
+                return false;
+            }
+        } else if (key == "--bg-interval") {
+            if (!parse_option_value(key, value, options.background_interval)) {
+                return false;
+            }
+            if (options.background_interval < 1) {
+                std::cerr << "Error: Background interval must be at least 1" << std::endl;
+                return false;
+            }
+        } else if (key == "--prototypes") {
+            if (!parse_option_value(key, value, options.class_prototypes)) {
+                return false;
+            }
+            if (options.class_prototypes < 0) {
+                std::cerr << "Error: Prototypes per class must be 0 or more" << std::endl;
+                return false;
+            }
+        } else if (key == "--bg-diff") {
+            if (!parse_option_value(key, value, options.background_difference)) {
+                return false;
+            }
+            if (options.background_difference < 0 || options.background_difference > 254) {
+                std::cerr << "Error: Background difference must be between 0 and 254" << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string pipeline_options_usage() {
+    return "Options:\n"
+           "  --threshold=gaussian|mean|background\n"
+           "                             Segmentation method (default gaussian)\n"
+           "  --block=N                  Odd adaptive threshold block size (default 11)\n"
+           "  --offset=C                 Constant subtracted from the local mean (default 2)\n"
+           "  --skip-static=T            Reuse the previous results when no tile's mean gray\n"
+           "                             change exceeds T (default 0, off)\n"
+           "  --gate-tile=N              Tile size in pixels for --skip-static (default 64)\n"
+           "  --coarse-to-fine           Find regions at 1/4 scale, segment at full scale only there\n"
+           "  --bg-update=average|median How the background follows the scene (default average)\n"
+           "  --bg-rate=A                Weight of each frame in the average background (default 0.05)\n"
+           "  --bg-interval=N            Update the background every N frames (default 1)\n"
+           "  --bg-diff=D                Gray difference from the background that is foreground\n"
+           "                             (default 25)\n"
+           "  --prototypes=K             Classify against K k-means prototypes per class instead of\n"
+           "                             every known object; 1 is the class mean (default 0, off)\n";
+}
+
+// Converts a BGR frame to grayscale one row at a time with the dispatched kernel.
+// The result is bit-exact with cv::cvtColor(..., cv::COLOR_BGR2GRAY).
+static cv::Mat to_gray(const cv::Mat& frame) {
+    if (frame.channels() == 1) {
+        return frame;
+    }
+    const VisionKernels& kernels = vision_kernels();
+    cv::Mat gray(frame.rows, frame.cols, CV_8UC1);
+    for (int y = 0; y < frame.rows; ++y) {
+        kernels.bgr_to_gray_row(frame.ptr<uchar>(y), gray.ptr<uchar>(y), frame.cols);
+    }
+    return gray;
+}
+
+namespace {
+
+// Fixed number of image rows kept in a circular buffer; row y lives in slot y % capacity.
+template <typename T>
+class RowRing {
+public:
+    void reset(int capacity, int width) {
+        capacity_ = capacity;
+        width_ = width;
+        data_.assign(static_cast<size_t>(capacity) * width, T());
+    }
+
+    T* row(int y) {
+        return data_.data() + static_cast<size_t>(y % capacity_) * width_;
+    }
+
+private:
+    int capacity_ = 1;
+    int width_ = 0;
+    std::vector<T> data_;
+};
+
+// Mirrors an index into [0, n) without repeating the edge (cv::BORDER_REFLECT_101).
+int reflect101(int i, int n) {
+    if (n == 1) return 0;
+    while (i < 0 || i >= n) {
+        i = i < 0 ? -i : 2 * (n - 1) - i;
+    }
+    return i;
+}
+
+// Writes rows [y0, y1) of the 5x5 Gaussian blur of frame into dst, whose row 0 is image
+// row y0. The two rows above and below come from the frame itself, so bands agree with a
+// whole-frame blur. BGR rows are converted to gray just before their horizontal pass, so
+// the gray image is never materialized.
+void gaussian_blur5_rows(const cv::Mat& frame, int y0, int y1, cv::Mat& dst) {
+    const int rows = frame.rows;
+    const int cols = frame.cols;
+    const VisionKernels& kernels = vision_kernels();
+    dst.create(y1 - y0, cols, CV_8UC1);
+
+    RowRing<std::uint16_t> hsum;
+    hsum.reset(5, cols);
+    std::vector<uchar> gray(cols);
+    int next = std::max(0, y0 - 2);
+
+    for (int y = y0; y < y1; ++y) {
+        for (; next <= std::min(y + 2, rows - 1); ++next) {
+            const uchar* src = frame.ptr<uchar>(next);
+            if (frame.channels() != 1) {
+                kernels.bgr_to_gray_row(src, gray.data(), cols);
+                src = gray.data();
+            }
+            kernels.gaussian5_row_h(src, hsum.row(next), cols);
+        }
+        const std::uint16_t* taps[5];
+        for (int k = 0; k < 5; ++k) {
+            taps[k] = hsum.row(reflect101(y + k - 2, rows));
+        }
+        kernels.gaussian5_row_v(taps, dst.ptr<uchar>(y - y0), cols);
+    }
+}
+
+// Gray histogram counted into four tables in turn, so runs of equal pixels do not stall on
+// incrementing the same counter. Scattered increments have no SIMD form before AVX-512
+// conflict detection; this is what breaks the dependency instead.
+class HistogramCounter {
+public:
+    void addRow(const uchar* row, int width) {
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            counts_[0][row[x]]++;
+            counts_[1][row[x + 1]]++;
+            counts_[2][row[x + 2]]++;
+            counts_[3][row[x + 3]]++;
+        }
+        for (; x < width; ++x) {
+            counts_[0][row[x]]++;
+        }
+    }
+
+    std::array<int, 256> total() const {
+        std::array<int, 256> histogram;
+        for (int g = 0; g < 256; ++g) {
+            histogram[g] = counts_[0][g] + counts_[1][g] + counts_[2][g] + counts_[3][g];
+        }
+        return histogram;
+    }
+
+private:
+    std::array<std::array<int, 256>, 4> counts_{};
+};
+
+// Converts rows of a gray or BGR frame into gray and counts their histogram in the same pass.
+cv::Mat gray_with_histogram(const cv::Mat& frame, std::array<int, 256>& histogram) {
+    const VisionKernels& kernels = vision_kernels();
+    cv::Mat gray(frame.rows, frame.cols, CV_8UC1);
+    HistogramCounter counter;
+    for (int y = 0; y < frame.rows; ++y) {
+        uchar* row = gray.ptr<uchar>(y);
+        if (frame.channels() == 1) {
+            std::copy(frame.ptr<uchar>(y), frame.ptr<uchar>(y) + frame.cols, row);
+        } else {
+            kernels.bgr_to_gray_row(frame.ptr<uchar>(y), row, frame.cols);
+        }
+        counter.addRow(row, frame.cols);
+    }
+    histogram = counter.total();
+    return gray;
+}
+
+} // namespace
+
+cv::Mat manual_threshold(const cv::Mat& frame, int threshold_value) {
+    if (threshold_value < 0) {
+        return cv::Mat(frame.rows, frame.cols, CV_8UC1, cv::Scalar(255));
+    }
+    if (threshold_value >= 255) {
+        return cv::Mat::zeros(frame.rows, frame.cols, CV_8UC1);
+    }
+
+    cv::Mat gray = to_gray(frame);
+    cv::Mat thresholded(gray.rows, gray.cols, CV_8UC1);
+    const VisionKernels& kernels = vision_kernels();
+    for (int y = 0; y < gray.rows; ++y) {
+        kernels.threshold_row(gray.ptr<uchar>(y), thresholded.ptr<uchar>(y), gray.cols,
+                              static_cast<uchar>(threshold_value), 255);
+    }
+    return thresholded;
+}
+
+cv::Mat manual_threshold(const cv::Mat& frame, AutoThreshold& automatic) {
+    std::array<int, 256> histogram;
+    cv::Mat gray = gray_with_histogram(frame, histogram);
+    const int threshold_value = automatic.update(histogram);
+    cv::Mat thresholded(gray.rows, gray.cols, CV_8UC1);
+    const VisionKernels& kernels = vision_kernels();
+    for (int y = 0; y < gray.rows; ++y) {
+        kernels.threshold_row(gray.ptr<uchar>(y), thresholded.ptr<uchar>(y), gray.cols,
+                              static_cast<uchar>(threshold_value), 255);
+    }
+    return thresholded;
+}
+
+int otsu_threshold(const std::array<int, 256>& histogram) {
+    double total = 0, sum = 0;
+    for (int g = 0; g < 256; ++g) {
+        total += histogram[g];
+        sum += static_cast<double>(g) * histogram[g];
+    }
+
+    double weight0 = 0, sum0 = 0, best = -1;
+    int threshold = 0;
+    for (int t = 0; t < 255; ++t) {
+        weight0 += histogram[t];
+        sum0 += static_cast<double>(t) * histogram[t];
+        const double weight1 = total - weight0;
+        if (weight0 == 0 || weight1 == 0) continue;
+        const double difference = sum0 / weight0 - (sum - sum0) / weight1;
+        const double between = weight0 * weight1 * difference * difference;
+        if (between > best) {
+            best = between;
+            threshold = t;
+        }
+    }
+    return threshold;
+}
+
+ThresholdSweep sweep_thresholds(const cv::Mat& frame, const std::vector<int>& thresholds, int min_region_size,
+                                std::pmr::memory_resource* memory) {
+    ThresholdSweep sweep;
+    const int planes = static_cast<int>(thresholds.size() + 7) / 8;
+    std::vector<std::array<uchar, 256>> bits(planes);
+    for (int plane = 0; plane < planes; ++plane) {
+        bits[plane].fill(0);
+        sweep.masks.emplace_back(frame.rows, frame.cols, CV_8UC1);
+    }
+    for (size_t k = 0; k < thresholds.size(); ++k) {
+        for (int g = std::max(0, thresholds[k] + 1); g < 256; ++g) {
+            bits[k / 8][g] |= static_cast<uchar>(1 << (k % 8));
+        }
+    }
+
+    // Gray conversion, histogram and packed masks in one pass over the rows
+    const VisionKernels& kernels = vision_kernels();
+    cv::Mat gray(frame.rows, frame.cols, CV_8UC1);
+    HistogramCounter counter;
+    for (int y = 0; y < frame.rows; ++y) {
+        uchar* row = gray.ptr<uchar>(y);
+        if (frame.channels() == 1) {
+            std::copy(frame.ptr<uchar>(y), frame.ptr<uchar>(y) + frame.cols, row);
+        } else {
+            kernels.bgr_to_gray_row(frame.ptr<uchar>(y), row, frame.cols);
+        }
+        counter.addRow(row, frame.cols);
+        for (int plane = 0; plane < planes; ++plane) {
+            uchar* mask = sweep.masks[plane].ptr<uchar>(y);
+            for (int x = 0; x < frame.cols; ++x) {
+                mask[x] = bits[plane][row[x]];
+            }
+        }
+    }
+    sweep.histogram = counter.total();
+    sweep.otsu = otsu_threshold(sweep.histogram);
+
+    // Pixels sorted by gray level, brightest first, with the histogram as the counting sort's
+    // offsets. Each one joins the 8-adjacent pixels already in; large counts the components
+    // of at least min_region_size pixels as they form and merge.
+    const int width = gray.cols;
+    const int n = static_cast<int>(gray.total());
+    std::array<int, 257> start{};
+    for (int g = 255; g >= 0; --g) {
+        start[g] = start[g + 1] + sweep.histogram[g];
+    }
+    std::pmr::vector<int> order(n, memory);
+    {
+        std::array<int, 256> next;
+        for (int g = 0; g < 256; ++g) {
+            next[g] = start[g + 1];
+        }
+        for (int y = 0, p = 0; y < gray.rows; ++y) {
+            const uchar* row = gray.ptr<uchar>(y);
+            for (int x = 0; x < width; ++x, ++p) {
+                order[next[row[x]]++] = p;
+            }
+        }
+    }
+
+    std::pmr::vector<int> parent(n, -1, memory);
+    std::pmr::vector<int> size(n, 0, memory);
+    auto find = [&](int p) {
+        while (parent[p] != p) {
+            parent[p] = parent[parent[p]];
+            p = parent[p];
+        }
+        return p;
+    };
+    const int min_size = std::max(1, min_region_size);
+    int large = 0;
+    for (int g = 255; g >= 1; --g) {
+        for (int i = start[g + 1]; i < start[g]; ++i) {
+            const int p = order[i];
+            parent[p] = p;
+            size[p] = 1;
+            large += min_size <= 1;
+            const int x = p % width, y = p / width;
+            for (int ny = std::max(0, y - 1); ny <= std::min(gray.rows - 1, y + 1); ++ny) {
+                for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx) {
+                    const int q = ny * width + nx;
+                    if (parent[q] < 0) continue;
+                    int a = find(p), b = find(q);
+                    if (a == b) continue;
+                    if (size[a] < size[b]) std::swap(a, b);
+                    large -= (size[a] >= min_size) + (size[b] >= min_size);
+                    parent[b] = a;
+                    size[a] += size[b];
+                    large += size[a] >= min_size;
+                }
+            }
+        }
+        sweep.regions[g - 1] = large;
+    }
+    return sweep;
+}
+
+cv::Mat gaussian_blur5(const cv::Mat& frame) {
+    cv::Mat blurred(frame.rows, frame.cols, CV_8UC1);
+    const int num_bands = (frame.rows + kFusedBandRows - 1) / kFusedBandRows;
+    cv::parallel_for_(cv::Range(0, num_bands), [&](const cv::Range& range) {
+        for (int band = range.start; band < range.end; ++band) {
+            const int y0 = band * kFusedBandRows;
+            const int y1 = std::min(frame.rows, y0 + kFusedBandRows);
+            cv::Mat band_rows = blurred.rowRange(y0, y1);
+            gaussian_blur5_rows(frame, y0, y1, band_rows);
+        }
+    });
+    return blurred;
+}
+
+cv::Mat preprocess_image(const cv::Mat& frame) {
+    return gaussian_blur5(frame);
+}
+
+cv::Mat adaptive_threshold(const cv::Mat& blurred, int block_size, double offset) {
+    cv::Mat thresholded;
+    cv::adaptiveThreshold(blurred, thresholded, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+                          cv::THRESH_BINARY_INV, block_size, offset);
+    return thresholded;
+}
+
+// Thresholds one row against the box mean, given the vertical window sums of every column.
+// padded is scratch space of cols + block_size - 1 entries; columns outside the image
+// replicate the edge column, as cv::adaptiveThreshold does.
+static void mean_threshold_row(const std::int32_t* column_sums, const uchar* src, uchar* dst,
+                               int cols, int block_size, int idelta, std::vector<std::int32_t>& padded) {
+    const int radius = block_size / 2;
+    const std::int64_t area = static_cast<std::int64_t>(block_size) * block_size;
+
+    std::copy(column_sums, column_sums + cols, padded.begin() + radius);
+    std::fill(padded.begin(), padded.begin() + radius, column_sums[0]);
+    std::fill(padded.end() - radius, padded.end(), column_sums[cols - 1]);
+
+    std::int32_t window = 0;
+    for (int k = 0; k < block_size; ++k) {
+        window += padded[k];
+    }
+
+    for (int x = 0; x < cols; ++x) {
+        // round(window / area) >= src + idelta, tested without dividing; area is odd,
+        // so the rounding never ties and this is exact
+        std::int64_t target = static_cast<std::int64_t>(src[x]) + idelta;
+        dst[x] = 2 * static_cast<std::int64_t>(window) + area >= 2 * target * area ? 255 : 0;
+        if (x + 1 < cols) {
+            window += padded[x + block_size] - padded[x];
+        }
+    }
+}
+
+cv::Mat mean_adaptive_threshold(const cv::Mat& gray, int block_size, double offset) {
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+    const int radius = block_size / 2;
+    // cv::adaptiveThreshold rounds the offset down for THRESH_BINARY_INV
+    const int idelta = static_cast<int>(std::floor(offset));
+    const int band_rows = std::max(kMinBandRows, block_size);
+    const int num_bands = (rows + band_rows - 1) / band_rows;
+    const VisionKernels& kernels = vision_kernels();
+
+    cv::Mat thresholded(rows, cols, CV_8UC1);
+    cv::parallel_for_(cv::Range(0, num_bands), [&](const cv::Range& range) {
+        std::vector<std::int32_t> column_sums(cols);
+        std::vector<std::int32_t> padded(cols + 2 * radius);
+        std::vector<uchar> zeros(cols, 0);
+
+        for (int band = range.start; band < range.end; ++band) {
+            const int y0 = band * band_rows;
+            const int y1 = std::min(rows, y0 + band_rows);
+            const int by0 = std::max(0, y0 - radius);
+            const int by1 = std::min(rows, y1 + radius);
+
+            cv::Mat blurred;
+            gaussian_blur5_rows(gray, by0, by1, blurred);
+
+            // Window rows outside the image replicate the edge row, as cv::adaptiveThreshold does
+            auto blurred_row = [&](int y) {
+                return blurred.ptr<uchar>(std::min(std::max(y, 0), rows - 1) - by0);
+            };
+
+            std::fill(column_sums.begin(), column_sums.end(), 0);
+            for (int dy = -radius; dy <= radius; ++dy) {
+                kernels.column_sum_update(column_sums.data(), blurred_row(y0 + dy), zeros.data(), cols);
+            }
+
+            for (int y = y0; y < y1; ++y) {
+                if (y > y0) {
+                    kernels.column_sum_update(column_sums.data(), blurred_row(y + radius),
+                                              blurred_row(y - radius - 1), cols);
+                }
+
+                mean_threshold_row(column_sums.data(), blurred_row(y), thresholded.ptr<uchar>(y),
+                                   cols, block_size, idelta, padded);
+            }
+        }
+    });
+    return thresholded;
+}
+
+cv::Mat threshold_image(const cv::Mat& frame, const PipelineOptions& options) {
+    CV_Assert(options.threshold_method != ThresholdMethod::Background);
+    if (options.threshold_method == ThresholdMethod::Mean) {
+        return mean_adaptive_threshold(to_gray(frame), options.block_size, options.threshold_offset);
+    }
+    return adaptive_threshold(preprocess_image(frame), options.block_size, options.threshold_offset);
+}
+
+cv::Mat clean_image(const cv::Mat& thresholded) {
+    cv::Mat cleaned;
+    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+    cv::morphologyEx(thresholded, cleaned, cv::MORPH_CLOSE, kernel);
+    cv::morphologyEx(cleaned, cleaned, cv::MORPH_OPEN, kernel);
+    return cleaned;
+}
+
+namespace {
+
+// Streams a band of rows from the BGR frame to the cleaned mask. Every stage keeps only
+// the few rows its consumer still needs in a ring buffer and produces rows on demand, so
+// a band goes through gray, blur, mean threshold, close and open while it is still in cache.
+// Each stage recomputes the halo rows its consumers need at the band edges, so bands are
+// independent and the result is identical to the whole-frame chain.
+class FusedBandSegmenter {
+public:
+    FusedBandSegmenter(const cv::Mat& frame, int block_size, double offset,
+                       cv::Mat& cleaned, cv::Mat* thresholded)
+        : frame_(frame), cleaned_(cleaned), thresholded_(thresholded),
+          kernels_(vision_kernels()), rows_(frame.rows), cols_(frame.cols),
+          block_size_(block_size), radius_(block_size / 2),
+          idelta_(static_cast<int>(std::floor(offset))) {
+        gray_.resize(cols_);
+        column_sums_.resize(cols_);
+        padded_.resize(cols_ + 2 * radius_);
+        zeros_.assign(cols_, 0);
+        hsum_.reset(5, cols_);
+        blurred_.reset(block_size_ + 1, cols_);
+        for (RowRing<uchar>& ring : morph_) {
+            ring.reset(3, cols_);
+        }
+    }
+
+    // Produces cleaned rows [y0, y1).
+    void run(int y0, int y1) {
+        y0_ = y0;
+        y1_ = y1;
+        // Extra rows each stage needs beyond the band: 1 per 3x3 morphology step after it,
+        // the threshold window radius after the blur, and 2 for the 5-tap vertical blur
+        const int halo[kNumStages] = {6 + radius_, 4 + radius_, 4, 3, 2, 1, 0};
+        for (int s = 0; s < kNumStages; ++s) {
+            lo_[s] = std::max(0, y0 - halo[s]);
+            next_[s] = lo_[s];
+        }
+        for (int y = y0; y < y1; ++y) {
+            produce(kOpenDilate, y);
+        }
+    }
+
+private:
+    enum Stage { kHSum, kBlur, kThreshold, kCloseDilate, kCloseErode, kOpenErode, kOpenDilate, kNumStages };
+
+    // Makes sure rows up to y of a stage have been produced.
+    void ensure(int stage, int y) {
+        while (next_[stage] <= y) {
+            produce(stage, next_[stage]++);
+        }
+    }
+
+    // Rows of the threshold and intermediate morphology stages.
+    uchar* stage_row(int stage, int y) {
+        return morph_[stage - kThreshold].row(y);
+    }
+
+    void produce(int stage, int y) {
+        switch (stage) {
+            case kHSum: produce_hsum(y); break;
+            case kBlur: produce_blur(y); break;
+            case kThreshold: produce_threshold(y); break;
+            default: produce_morph(stage, y); break;
+        }
+    }
+
+    // Gray conversion followed by the horizontal 1-4-6-4-1 pass of the 5x5 Gaussian.
+    void produce_hsum(int y) {
+        const uchar* gray = frame_.ptr<uchar>(y);
+        if (frame_.channels() != 1) {
+            kernels_.bgr_to_gray_row(gray, gray_.data(), cols_);
+            gray = gray_.data();
+        }
+        kernels_.gaussian5_row_h(gray, hsum_.row(y), cols_);
+    }
+
+    // Vertical 1-4-6-4-1 pass, rows reflected at the image edges.
+    void produce_blur(int y) {
+        ensure(kHSum, std::min(y + 2, rows_ - 1));
+        const std::uint16_t* taps[5];
+        for (int k = 0; k < 5; ++k) {
+            taps[k] = hsum_.row(reflect101(y + k - 2, rows_));
+        }
+        kernels_.gaussian5_row_v(taps, blurred_.row(y), cols_);
+    }
+
+    // Window rows outside the image replicate the edge row, as cv::adaptiveThreshold does.
+    const uchar* clamped_blurred_row(int y) {
+        return blurred_.row(std::min(std::max(y, 0), rows_ - 1));
+    }
+
+    void produce_threshold(int y) {
+        ensure(kBlur, std::min(y + radius_, rows_ - 1));
+        if (y == lo_[kThreshold]) {
+            std::fill(column_sums_.begin(), column_sums_.end(), 0);
+            for (int dy = -radius_; dy <= radius_; ++dy) {
+                kernels_.column_sum_update(column_sums_.data(), clamped_blurred_row(y + dy), zeros_.data(), cols_);
+            }
+        } else {
+            kernels_.column_sum_update(column_sums_.data(), clamped_blurred_row(y + radius_),
+                                       clamped_blurred_row(y - radius_ - 1), cols_);
+        }
+
+        uchar* dst = stage_row(kThreshold, y);
+        mean_threshold_row(column_sums_.data(), blurred_.row(y), dst, cols_, block_size_, idelta_, padded_);
+        if (thresholded_ && y >= y0_ && y < y1_) {
+            std::copy(dst, dst + cols_, thresholded_->ptr<uchar>(y));
+        }
+    }
+
+    // One 3x3 step of the close (dilate, erode) and open (erode, dilate) sequence.
+    void produce_morph(int stage, int y) {
+        const int source = stage - 1;
+        ensure(source, std::min(y + 1, rows_ - 1));
+        const uchar* above = y > 0 ? stage_row(source, y - 1) : nullptr;
+        const uchar* below = y + 1 < rows_ ? stage_row(source, y + 1) : nullptr;
+        const bool dilate = stage == kCloseDilate || stage == kOpenDilate;
+        uchar* dst = stage == kOpenDilate ? cleaned_.ptr<uchar>(y) : stage_row(stage, y);
+        kernels_.morph3_row(above, stage_row(source, y), below, dst, cols_, dilate);
+    }
+
+    const cv::Mat& frame_;
+    cv::Mat& cleaned_;
+    cv::Mat* thresholded_;
+    const VisionKernels& kernels_;
+    const int rows_;
+    const int cols_;
+    const int block_size_;
+    const int radius_;
+    const int idelta_;
+
+    int y0_ = 0;
+    int y1_ = 0;
+    int lo_[kNumStages] = {};
+    int next_[kNumStages] = {};
+
+    std::vector<uchar> gray_;
+    std::vector<std::int32_t> column_sums_;
+    std::vector<std::int32_t> padded_;
+    std::vector<uchar> zeros_;
+    RowRing<std::uint16_t> hsum_;
+    RowRing<uchar> blurred_;
+    RowRing<uchar> morph_[4];  // threshold, close dilate, close erode, open erode
+};
+
+} // namespace
+
+cv::Mat segment_frame(const cv::Mat& frame, const PipelineOptions& options, cv::Mat* thresholded) {
+    if (options.threshold_method != ThresholdMethod::Mean) {
+        cv::Mat mask = threshold_image(frame, options);
+        if (thresholded) {
+            *thresholded = mask;
+        }
+        return clean_image(mask);
+    }
+
+    cv::Mat cleaned(frame.rows, frame.cols, CV_8UC1);
+    if (thresholded) {
+        thresholded->create(frame.rows, frame.cols, CV_8UC1);
+    }
+
+    const int band_rows = std::max(kFusedBandRows, 4 * options.block_size);
+    const int num_bands = (frame.rows + band_rows - 1) / band_rows;
+    cv::parallel_for_(cv::Range(0, num_bands), [&](const cv::Range& range) {
+        FusedBandSegmenter segmenter(frame, options.block_size, options.threshold_offset, cleaned, thresholded);
+        for (int band = range.start; band < range.end; ++band) {
+            segmenter.run(band * band_rows, std::min(frame.rows, (band + 1) * band_rows));
+        }
+    });
+    return cleaned;
+}
+
+cv::Mat BackgroundModel::segment(const cv::Mat& frame, cv::Mat* thresholded) {
+    const int rows = frame.rows;
+    const int cols = frame.cols;
+    const VisionKernels& kernels = vision_kernels();
+    cv::Mat mask(rows, cols, CV_8UC1);
+
+    const bool initialize = background.size() != frame.size();
+    if (initialize) {
+        background.create(rows, cols, CV_16UC1);
+        framesSinceUpdate = 0;
+    }
+    const bool update = !initialize && ++framesSinceUpdate >= options.background_interval;
+    if (update) {
+        framesSinceUpdate = 0;
+    }
+    const int rate = std::min(255, std::max(1, static_cast<int>(std::lround(options.background_rate * 256))));
+    const uchar difference = static_cast<uchar>(options.background_difference);
+
+    const int num_bands = (rows + kFusedBandRows - 1) / kFusedBandRows;
+    cv::parallel_for_(cv::Range(0, num_bands), [&](const cv::Range& range) {
+        std::vector<uchar> gray_row(cols);
+        for (int y = range.start * kFusedBandRows; y < std::min(rows, range.end * kFusedBandRows); ++y) {
+            const uchar* gray = frame.ptr<uchar>(y);
+            if (frame.channels() != 1) {
+                kernels.bgr_to_gray_row(gray, gray_row.data(), cols);
+                gray = gray_row.data();
+            }
+            std::uint16_t* bg = background.ptr<std::uint16_t>(y);
+            uchar* dst = mask.ptr<uchar>(y);
+            if (initialize) {
+                for (int x = 0; x < cols; ++x) {
+                    bg[x] = static_cast<std::uint16_t>(gray[x] << 8);
+                }
+                std::fill(dst, dst + cols, 0);
+                continue;
+            }
+            // The difference is taken before the update, so new objects show at full contrast
+            kernels.background_diff_row(bg, gray, dst, cols, difference);
+            if (!update) continue;
+            if (options.background_update == BackgroundUpdate::Median) {
+                kernels.background_median_row(bg, gray, cols);
+            } else {
+                kernels.background_average_row(bg, gray, cols, rate);
+            }
+        }
+    });
+
+    if (thresholded) {
+        *thresholded = mask;
+    }
+    return clean_image(mask);
+}
+
+int segmentation_halo(const PipelineOptions& options) {
+    return 2 + options.block_size / 2 + 4;
+}
+
+// Segments rect of the frame, plus its halo, into cleaned and thresholded and returns the
+// rectangle that was written. Segmenting the input rectangle treats its sides as image
+// borders, which only affects pixels within the halo of those sides, outside the written
+// rectangle, so the written pixels match a whole-frame segment_frame exactly.
+static cv::Rect segment_rect(const cv::Mat& frame, const PipelineOptions& options, const cv::Rect& rect,
+                             cv::Mat& cleaned, cv::Mat& thresholded) {
+    const cv::Rect image(0, 0, frame.cols, frame.rows);
+    const int halo = segmentation_halo(options);
+    cv::Rect out = cv::Rect(rect.x - halo, rect.y - halo, rect.width + 2 * halo, rect.height + 2 * halo) & image;
+    cv::Rect in = cv::Rect(out.x - halo, out.y - halo, out.width + 2 * halo, out.height + 2 * halo) & image;
+    cv::Mat tile_thresholded;
+    cv::Mat tile_cleaned = segment_frame(frame(in), options, &tile_thresholded);
+    const cv::Rect inner(out.x - in.x, out.y - in.y, out.width, out.height);
+    tile_cleaned(inner).copyTo(cleaned(out));
+    tile_thresholded(inner).copyTo(thresholded(out));
+    return out;
+}
+
+// Merges rectangles that overlap or touch until all of them are separated by at least one pixel.
+template <typename Rects>
+static void merge_rects(Rects& rects) {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && !merged; ++i) {
+            const cv::Rect grown(rects[i].x - 1, rects[i].y - 1, rects[i].width + 2, rects[i].height + 2);
+            for (size_t j = i + 1; j < rects.size(); ++j) {
+                if ((grown & rects[j]).area() > 0) {
+                    rects[i] |= rects[j];
+                    rects.erase(rects.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+std::vector<cv::Rect> find_coarse_candidates(const cv::Mat& frame, const PipelineOptions& options,
+                                             int min_region_size) {
+    cv::Mat small;
+    cv::resize(frame, small, cv::Size((frame.cols + kCoarseScale - 1) / kCoarseScale,
+                                      (frame.rows + kCoarseScale - 1) / kCoarseScale),
+               0, 0, cv::INTER_AREA);
+    PipelineOptions coarse = options;
+    coarse.block_size = std::max(3, (options.block_size / kCoarseScale) | 1);
+    cv::Mat mask = segment_frame(small, coarse);
+
+    cv::Mat stats;
+    int num_labels = label_components(mask, nullptr, stats);
+
+    const cv::Rect image(0, 0, frame.cols, frame.rows);
+    const int margin = kCoarseMarginCells * kCoarseScale;
+    std::vector<cv::Rect> candidates;
+    for (int i = 1; i < num_labels; ++i) {
+        // Half the minimum area, so regions the downscale shrank are not lost
+        if (2 * stats.at<int>(i, cv::CC_STAT_AREA) * kCoarseScale * kCoarseScale < min_region_size) continue;
+        cv::Rect box(stats.at<int>(i, cv::CC_STAT_LEFT) * kCoarseScale - margin,
+                     stats.at<int>(i, cv::CC_STAT_TOP) * kCoarseScale - margin,
+                     stats.at<int>(i, cv::CC_STAT_WIDTH) * kCoarseScale + 2 * margin,
+                     stats.at<int>(i, cv::CC_STAT_HEIGHT) * kCoarseScale + 2 * margin);
+        candidates.push_back(box & image);
+    }
+    merge_rects(candidates);
+    return candidates;
+}
+
+cv::Mat segment_frame_coarse_to_fine(const cv::Mat& frame, const PipelineOptions& options, int min_region_size,
+                                     cv::Mat* thresholded, std::vector<cv::Rect>* computed) {
+    cv::Mat cleaned = cv::Mat::zeros(frame.rows, frame.cols, CV_8UC1);
+    cv::Mat mask = cv::Mat::zeros(frame.rows, frame.cols, CV_8UC1);
+    std::vector<cv::Rect> written;
+    for (const cv::Rect& rect : find_coarse_candidates(frame, options, min_region_size)) {
+        written.push_back(segment_rect(frame, options, rect, cleaned, mask));
+    }
+    if (thresholded) {
+        *thresholded = mask;
+    }
+    if (computed) {
+        *computed = written;
+    }
+    return cleaned;
+}
+
+// Sums of x, x^2 and x^3 over 0..k, for k >= -1.
+static std::int64_t sum_powers1(std::int64_t k) { return k * (k + 1) / 2; }
+static std::int64_t sum_powers2(std::int64_t k) { return k * (k + 1) * (2 * k + 1) / 6; }
+static std::int64_t sum_powers3(std::int64_t k) { return sum_powers1(k) * sum_powers1(k); }
+
+void RawMoments::addRun(int x0, int x1, std::int64_t y) {
+    const std::int64_t n = x1 - x0 + 1;
+    const std::int64_t sx = sum_powers1(x1) - sum_powers1(x0 - 1);
+    const std::int64_t sxx = sum_powers2(x1) - sum_powers2(x0 - 1);
+    const std::int64_t sxxx = sum_powers3(x1) - sum_powers3(x0 - 1);
+    m00 += n;
+    m10 += sx;
+    m01 += y * n;
+    m20 += sxx;
+    m11 += y * sx;
+    m02 += y * y * n;
+    m30 += sxxx;
+    m21 += y * sxx;
+    m12 += y * y * sx;
+    m03 += y * y * y * n;
+}
+
+void RawMoments::add(const RawMoments& other, std::int64_t dx, std::int64_t dy) {
+    const std::int64_t n = other.m00;
+    m30 += other.m30 + 3 * dx * other.m20 + 3 * dx * dx * other.m10 + dx * dx * dx * n;
+    m21 += other.m21 + dy * other.m20 + 2 * dx * other.m11 + 2 * dx * dy * other.m10 + dx * dx * other.m01 +
+           dx * dx * dy * n;
+    m12 += other.m12 + dx * other.m02 + 2 * dy * other.m11 + 2 * dx * dy * other.m01 + dy * dy * other.m10 +
+           dx * dy * dy * n;
+    m03 += other.m03 + 3 * dy * other.m02 + 3 * dy * dy * other.m01 + dy * dy * dy * n;
+    m20 += other.m20 + 2 * dx * other.m10 + dx * dx * n;
+    m11 += other.m11 + dx * other.m01 + dy * other.m10 + dx * dy * n;
+    m02 += other.m02 + 2 * dy * other.m01 + dy * dy * n;
+    m10 += other.m10 + dx * n;
+    m01 += other.m01 + dy * n;
+    m00 += n;
+}
+
+cv::Point2d RawMoments::centroid() const {
+    const double n = static_cast<double>(m00);
+    return cv::Point2d(m10 / n, m01 / n);
+}
+
+CentralMoments RawMoments::central() const {
+    // Same reduction as cv::moments, once per component
+    const double n = static_cast<double>(m00);
+    const double cx = m10 / n, cy = m01 / n;
+    CentralMoments c;
+    c.mu20 = m20 - m10 * cx;
+    c.mu11 = m11 - m10 * cy;
+    c.mu02 = m02 - m01 * cy;
+    c.mu30 = m30 - cx * (3 * c.mu20 + cx * m10);
+    c.mu21 = m21 - cx * (2 * c.mu11 + cx * m01) - cy * c.mu20;
+    c.mu12 = m12 - cy * (2 * c.mu11 + cy * m10) - cx * c.mu02;
+    c.mu03 = m03 - cy * (3 * c.mu02 + cy * m01);
+    return c;
+}
+
+double CentralMoments::axis() const {
+    return 0.5 * std::atan2(2 * mu11, mu20 - mu02);
+}
+
+void CentralMoments::huMoments(double area, double hu[7]) const {
+    // Scale-normalized moments nu_pq = mu_pq / area^(1 + (p + q) / 2)
+    const double s2 = 1.0 / (area * area);
+    const double s3 = s2 / std::sqrt(area);
+    const double nu20 = mu20 * s2, nu11 = mu11 * s2, nu02 = mu02 * s2;
+    const double nu30 = mu30 * s3, nu21 = mu21 * s3, nu12 = mu12 * s3, nu03 = mu03 * s3;
+
+    const double t0 = nu30 + nu12;
+    const double t1 = nu21 + nu03;
+    const double q0 = nu20 - nu02;
+    const double q1 = nu30 - 3 * nu12;
+    const double q2 = 3 * nu21 - nu03;
+    hu[0] = nu20 + nu02;
+    hu[1] = q0 * q0 + 4 * nu11 * nu11;
+    hu[2] = q1 * q1 + q2 * q2;
+    hu[3] = t0 * t0 + t1 * t1;
+    hu[4] = q1 * t0 * (t0 * t0 - 3 * t1 * t1) + q2 * t1 * (3 * t0 * t0 - t1 * t1);
+    hu[5] = q0 * (t0 * t0 - t1 * t1) + 4 * nu11 * t0 * t1;
+    hu[6] = q2 * t0 * (t0 * t0 - 3 * t1 * t1) - q1 * t1 * (3 * t0 * t0 - t1 * t1);
+}
+
+// Weight of each 2x2 bit-quad pattern (bit 0 top-left, 1 top-right, 2 bottom-left, 3 bottom-right)
+// in Gray's 8-connectivity Euler number: +1 for one set pixel, -1 for three, -2 for a diagonal
+// pair. Summed over every quad of the image, padded with background, it is 4 times the Euler
+// number. All set pixels of a quad are 8-adjacent, so each quad belongs to a single component.
+static const int kQuadWeight[16] = {0, 1, 1, 0, 1, 0, -2, -1, 1, -2, 0, -1, 0, -1, -1, 0};
+
+// Compactness 4 pi A / P^2 from the area and crack perimeter.
+static double region_compactness(double area, double perimeter) {
+    return perimeter > 0 ? 4.0 * CV_PI * area / (perimeter * perimeter) : 0.0;
+}
+
+// A horizontal run of set mask pixels and its provisional label.
+struct ComponentRun {
+    int x0, x1, y;
+    int label;
+};
+
+static int find_run_root(std::pmr::vector<int>& parent, int label) {
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+// Writes the final label of every run into the label image, and zeros between the runs, one
+// row at a time so each pixel is written once.
+template <typename Label>
+static void write_label_image(const std::pmr::vector<ComponentRun>& runs, const std::pmr::vector<int>& final_label,
+                              cv::Mat& labels) {
+    size_t r = 0;
+    for (int y = 0; y < labels.rows; ++y) {
+        Label* row = labels.ptr<Label>(y);
+        int x = 0;
+        for (; r < runs.size() && runs[r].y == y; ++r) {
+            std::fill(row + x, row + runs[r].x0, Label(0));
+            std::fill(row + runs[r].x0, row + runs[r].x1 + 1, static_cast<Label>(final_label[runs[r].label]));
+            x = runs[r].x1 + 1;
+        }
+        std::fill(row + x, row + labels.cols, Label(0));
+    }
+}
+
+int label_components(const cv::Mat& mask, cv::Mat* labels, cv::Mat& stats, std::pmr::memory_resource* memory) {
+    // First pass: runs of each row, joined to the 8-adjacent runs of the row above through a
+    // union-find on provisional labels. Roots are always the smaller label.
+    std::pmr::vector<ComponentRun> runs(memory);
+    std::pmr::vector<int> parent(memory);
+    size_t previous_begin = 0, previous_end = 0;
+    for (int y = 0; y < mask.rows; ++y) {
+        const uchar* row = mask.ptr<uchar>(y);
+        const size_t current_begin = runs.size();
+        size_t p = previous_begin;
+        for (int x = 0; x < mask.cols;) {
+            if (!row[x]) {
+                ++x;
+                continue;
+            }
+            const int x0 = x;
+            while (x < mask.cols && row[x]) ++x;
+            const int x1 = x - 1;
+
+            while (p < previous_end && runs[p].x1 < x0 - 1) ++p;
+            int label = -1;
+            for (size_t q = p; q < previous_end && runs[q].x0 <= x1 + 1; ++q) {
+                const int other = find_run_root(parent, runs[q].label);
+                if (label < 0) {
+                    label = other;
+                } else if (other != label) {
+                    parent[std::max(label, other)] = std::min(label, other);
+                    label = std::min(label, other);
+                }
+            }
+            if (label < 0) {
+                label = static_cast<int>(parent.size());
+                parent.push_back(label);
+            }
+            runs.push_back({x0, x1, y, label});
+        }
+        previous_begin = current_begin;
+        previous_end = runs.size();
+    }
+
+    // Final labels in the order the components were first reached, like a raster scan
+    std::pmr::vector<int> final_label(parent.size(), memory);
+    int num_labels = 1;
+    for (size_t i = 0; i < parent.size(); ++i) {
+        final_label[i] = parent[i] == static_cast<int>(i) ? num_labels++ : final_label[find_run_root(parent, i)];
+    }
+
+    stats.create(num_labels, 5, CV_32S);
+    std::pmr::vector<int> right(num_labels, -1, memory), bottom(num_labels, -1, memory);
+    for (int l = 1; l < num_labels; ++l) {
+        stats.at<int>(l, cv::CC_STAT_LEFT) = mask.cols;
+        stats.at<int>(l, cv::CC_STAT_TOP) = mask.rows;
+        stats.at<int>(l, cv::CC_STAT_AREA) = 0;
+    }
+    long long foreground = 0;
+    for (const ComponentRun& run : runs) {
+        const int l = final_label[run.label];
+        int* row = stats.ptr<int>(l);
+        row[cv::CC_STAT_LEFT] = std::min(row[cv::CC_STAT_LEFT], run.x0);
+        row[cv::CC_STAT_TOP] = std::min(row[cv::CC_STAT_TOP], run.y);
+        row[cv::CC_STAT_AREA] += run.x1 - run.x0 + 1;
+        right[l] = std::max(right[l], run.x1);
+        bottom[l] = run.y;
+        foreground += run.x1 - run.x0 + 1;
+    }
+    for (int l = 1; l < num_labels; ++l) {
+        stats.at<int>(l, cv::CC_STAT_WIDTH) = right[l] - stats.at<int>(l, cv::CC_STAT_LEFT) + 1;
+        stats.at<int>(l, cv::CC_STAT_HEIGHT) = bottom[l] - stats.at<int>(l, cv::CC_STAT_TOP) + 1;
+    }
+    stats.at<int>(0, cv::CC_STAT_LEFT) = 0;
+    stats.at<int>(0, cv::CC_STAT_TOP) = 0;
+    stats.at<int>(0, cv::CC_STAT_WIDTH) = mask.cols;
+    stats.at<int>(0, cv::CC_STAT_HEIGHT) = mask.rows;
+    stats.at<int>(0, cv::CC_STAT_AREA) = static_cast<int>(static_cast<long long>(mask.total()) - foreground);
+
+    if (labels) {
+        if (num_labels - 1 <= std::numeric_limits<ushort>::max()) {
+            labels->create(mask.size(), CV_16U);
+            write_label_image<ushort>(runs, final_label, *labels);
+        } else {
+            labels->create(mask.size(), CV_32S);
+            write_label_image<int>(runs, final_label, *labels);
+        }
+    }
+    return num_labels;
+}
+
+// Per-label results of the labeling scan.
+struct LabelStatistics {
+    RawMoments moments;      // Relative to the label's bounding box corner
+    int quadSum = 0;         // Sum of kQuadWeight over the quads touching the label
+    long long perimeter = 0; // Cracks between the label and background
+    int rowOffset = 0;       // First row of the label in LabelScan::rowMin and rowMax
+};
+
+// Results of the labeling scan for every label. The row extents of all labels share two arrays.
+struct LabelScan {
+    std::pmr::vector<LabelStatistics> labels;
+    std::pmr::vector<int> rowMin, rowMax;  // Extent of each label row, relative to its corner, when asked for
+
+    explicit LabelScan(std::pmr::memory_resource* memory) : labels(memory), rowMin(memory), rowMax(memory) {}
+};
+
+// Convex hull of a region from the leftmost and rightmost pixel of each of its rows, the only
+// pixels that can be hull vertices. Those points already come sorted by row and then column,
+// so Andrew's monotone chain builds the hull in one pass over the rows, without sorting.
+static std::vector<cv::Point> row_extent_hull(const int* row_min, const int* row_max, int rows, const cv::Point& corner,
+                                              std::pmr::memory_resource* memory) {
+    std::pmr::vector<cv::Point> points(memory);
+    points.reserve(2 * rows);
+    for (int r = 0; r < rows; ++r) {
+        const int y = corner.y + r;
+        points.emplace_back(corner.x + row_min[r], y);
+        if (row_max[r] != row_min[r]) {
+            points.emplace_back(corner.x + row_max[r], y);
+        }
+    }
+    if (points.size() < 3) {
+        return std::vector<cv::Point>(points.begin(), points.end());
+    }
+
+    auto cross = [](const cv::Point& o, const cv::Point& a, const cv::Point& b) {
+        return static_cast<long long>(a.x - o.x) * (b.y - o.y) - static_cast<long long>(a.y - o.y) * (b.x - o.x);
+    };
+    std::vector<cv::Point> hull(2 * points.size());
+    size_t k = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) --k;
+        hull[k++] = points[i];
+    }
+    for (size_t i = points.size() - 1, chain = k + 1; i-- > 0;) {
+        while (k >= chain && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) --k;
+        hull[k++] = points[i];
+    }
+    hull.resize(k - 1);
+    return hull;
+}
+
+// Accumulates the raw moments, bit-quad sums and crack perimeters of every label of a
+// label image and its stats in one scan. Moments are added run by run; quads are taken
+// between each row and the one above it, including the background border around the image. The
+// right and bottom edges of a quad's top-right pixel meet every horizontal and vertical pixel
+// pair exactly once, so the cracks are counted there. 4-adjacent set pixels always share a label.
+// With row_extents, the first and last run of a label in each row also give that row's extent.
+template <typename Label>
+static void scan_label_statistics(const cv::Mat& labels, const cv::Mat& stats, bool row_extents, LabelScan& scan) {
+    std::pmr::vector<LabelStatistics>& statistics = scan.labels;
+    for (int y = 0; y <= labels.rows; ++y) {
+        const Label* above = y > 0 ? labels.ptr<Label>(y - 1) : nullptr;
+        const Label* row = y < labels.rows ? labels.ptr<Label>(y) : nullptr;
+        for (int x = 0; x <= labels.cols; ++x) {
+            const int a = above && x > 0 ? above[x - 1] : 0;
+            const int b = above && x < labels.cols ? above[x] : 0;
+            const int c = row && x > 0 ? row[x - 1] : 0;
+            const int d = row && x < labels.cols ? row[x] : 0;
+            const int weight = kQuadWeight[(a != 0) | (b != 0) << 1 | (c != 0) << 2 | (d != 0) << 3];
+            if (weight != 0) {
+                statistics[a ? a : b ? b : c ? c : d].quadSum += weight;
+            }
+            if ((b != 0) != (d != 0)) {
+                statistics[b ? b : d].perimeter++;
+            }
+            if ((c != 0) != (d != 0)) {
+                statistics[c ? c : d].perimeter++;
+            }
+        }
+        if (!row) break;
+
+        for (int x = 0; x < labels.cols;) {
+            const int l = row[x];
+            const int x0 = x;
+            while (x < labels.cols && row[x] == l) ++x;
+            if (l == 0) continue;
+            const int left = stats.at<int>(l, cv::CC_STAT_LEFT);
+            const int r = y - stats.at<int>(l, cv::CC_STAT_TOP);
+            statistics[l].moments.addRun(x0 - left, x - 1 - left, r);
+            if (row_extents) {
+                const int i = statistics[l].rowOffset + r;
+                if (scan.rowMax[i] < 0) scan.rowMin[i] = x0 - left;
+                scan.rowMax[i] = x - 1 - left;
+            }
+        }
+    }
+}
+
+// Runs the scan for a CV_16U label image from label_components or a CV_32S one.
+static LabelScan label_statistics(const cv::Mat& labels, const cv::Mat& stats, int num_labels, bool row_extents,
+                                  std::pmr::memory_resource* memory) {
+    LabelScan scan(memory);
+    scan.labels.resize(num_labels);
+    if (row_extents) {
+        int rows = 0;
+        for (int l = 1; l < num_labels; ++l) {
+            scan.labels[l].rowOffset = rows;
+            rows += stats.at<int>(l, cv::CC_STAT_HEIGHT);
+        }
+        scan.rowMin.resize(rows);
+        scan.rowMax.resize(rows, -1);
+    }
+    if (labels.depth() == CV_16U) {
+        scan_label_statistics<ushort>(labels, stats, row_extents, scan);
+    } else {
+        scan_label_statistics<int>(labels, stats, row_extents, scan);
+    }
+    return scan;
+}
+
+// Computes the properties of one connected component of the cleaned mask from its bounding
+// box and the labeling scan results of its label.
+static Region describe_region(const cv::Mat& cleaned, const cv::Rect& box, const LabelScan& scan, int label,
+                              bool compute_oriented_box, std::pmr::memory_resource* memory) {
+    const LabelStatistics& statistics = scan.labels[label];
+    const RawMoments& moments = statistics.moments;
+    Region region;
+    region.area = static_cast<int>(moments.m00);
+    region.centroid = moments.centroid() + cv::Point2d(box.x, box.y);
+    region.boundingBox = box;
+
+    region.aspectRatio = static_cast<double>(region.boundingBox.width) /
+                         static_cast<double>(region.boundingBox.height);
+
+    region.touchesBoundary =
+        region.boundingBox.x <= 0 ||
+        region.boundingBox.y <= 0 ||
+        region.boundingBox.x + region.boundingBox.width >= cleaned.cols ||
+        region.boundingBox.y + region.boundingBox.height >= cleaned.rows;
+
+    // Calculate percent filled
+    region.percentFilled = static_cast<double>(region.area) / (region.boundingBox.width * region.boundingBox.height);
+
+    // Least central moment axis and Hu invariants of the component's own pixels
+    const CentralMoments central = moments.central();
+    region.leastCentralMomentAxis = central.axis();
+    central.huMoments(region.area, region.huMoments);
+
+    // Topology from the bit-quads
+    region.eulerNumber = statistics.quadSum / 4;
+    region.holes = 1 - region.eulerNumber;
+
+    // Boundary length from the crack count
+    region.perimeter = static_cast<int>(statistics.perimeter);
+    region.compactness = region_compactness(region.area, region.perimeter);
+
+    // Oriented bounding box of the hull, which has the same minimum-area rectangle as the pixels
+    if (compute_oriented_box) {
+        region.convexHull = row_extent_hull(scan.rowMin.data() + statistics.rowOffset,
+                                            scan.rowMax.data() + statistics.rowOffset, box.height, box.tl(), memory);
+        region.orientedBoundingBox = cv::minAreaRect(region.convexHull);
+    }
+
+    // Initialize color (will be set properly during visualization)
+    region.color = cv::Vec3b(0, 0, 0);
+    return region;
+}
+
+RegionBatch extract_regions(const cv::Mat& cleaned, int min_region_size, bool compute_oriented_box,
+                            std::pmr::memory_resource* memory) {
+    cv::Mat labels, stats;
+    int num_labels = label_components(cleaned, &labels, stats, memory);
+    LabelScan scan = label_statistics(labels, stats, num_labels, compute_oriented_box, memory);
+
+    RegionBatch regions;
+    for (int i = 1; i < num_labels; ++i) {
+        int area = stats.at<int>(i, cv::CC_STAT_AREA);
+        if (area < min_region_size) continue;
+
+        cv::Rect box(stats.at<int>(i, cv::CC_STAT_LEFT), stats.at<int>(i, cv::CC_STAT_TOP),
+                     stats.at<int>(i, cv::CC_STAT_WIDTH), stats.at<int>(i, cv::CC_STAT_HEIGHT));
+        regions.add(describe_region(cleaned, box, scan, i, compute_oriented_box, memory));
+    }
+
+    regions.sortByAreaDescending(memory);
+    return regions;
+}
+
+bool TiledImageReader::openNetpbm(const std::string& path) {
+    file.open(path, std::ios::binary);
+    if (!file) return false;
+    std::string magic;
+    file >> magic;
+    if (magic != "P5" && magic != "P6") return false;
+
+    // Width, height and maxval, with '#' comments allowed between them
+    int values[3];
+    for (int& value : values) {
+        file >> std::ws;
+        while (file.peek() == '#') {
+            file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            file >> std::ws;
+        }
+        if (!(file >> value)) return false;
+    }
+    if (values[0] <= 0 || values[1] <= 0 || values[2] <= 0 || values[2] > 255) return false;
+    file.get();  // The single whitespace character before the pixel data
+
+    size = cv::Size(values[0], values[1]);
+    channels = magic == "P6" ? 3 : 1;
+    dataOffset = file.tellg();
+    return true;
+}
+
+bool TiledImageReader::open(const std::string& path) {
+    decoded.release();
+    if (openNetpbm(path)) {
+        return true;
+    }
+    file.close();
+    decoded = cv::imread(path, cv::IMREAD_COLOR);
+    if (decoded.empty()) {
+        std::cerr << "Error: Could not read image file " << path << std::endl;
+        return false;
+    }
+    size = decoded.size();
+    channels = decoded.channels();
+    return true;
+}
+
+cv::Mat TiledImageReader::read(const cv::Rect& rect) {
+    if (!decoded.empty()) {
+        return decoded(rect).clone();
+    }
+    cv::Mat pixels(rect.height, rect.width, channels == 3 ? CV_8UC3 : CV_8UC1);
+    const std::streamoff row_bytes = static_cast<std::streamoff>(size.width) * channels;
+    for (int y = 0; y < rect.height; ++y) {
+        file.seekg(dataOffset + (rect.y + y) * row_bytes + static_cast<std::streamoff>(rect.x) * channels);
+        file.read(reinterpret_cast<char*>(pixels.ptr<uchar>(y)), static_cast<std::streamsize>(rect.width) * channels);
+    }
+    if (!file) {
+        file.clear();
+        std::cerr << "Error: Image file is shorter than its header says" << std::endl;
+    }
+    if (channels == 3) {
+        cv::cvtColor(pixels, pixels, cv::COLOR_RGB2BGR);  // PPM stores RGB
+    }
+    return pixels;
+}
+
+namespace {
+
+// A component of the tiled extraction. The centroid and the moments are kept as the mean and
+// the central moments about it, which merge without growing with the offsets.
+struct TiledComponent {
+    int parent;
+    long long area;
+    int left, top, right, bottom;  // Inclusive
+    double meanX, meanY;
+    CentralMoments central;
+    int quadSum;  // Sum of kQuadWeight over the component's bit-quads
+    long long perimeter;
+};
+
+int find_tiled_root(std::vector<TiledComponent>& components, int i) {
+    while (components[i].parent != i) {
+        components[i].parent = components[components[i].parent].parent;
+        i = components[i].parent;
+    }
+    return i;
+}
+
+// Central moments of n pixels about a point at offset (-ex, -ey) from their centroid: the
+// binomial expansion of sums of (x + ex)^p (y + ey)^q, where first-order central sums vanish.
+CentralMoments shift_central_moments(const CentralMoments& c, double n, double ex, double ey) {
+    CentralMoments s;
+    s.mu20 = c.mu20 + ex * ex * n;
+    s.mu11 = c.mu11 + ex * ey * n;
+    s.mu02 = c.mu02 + ey * ey * n;
+    s.mu30 = c.mu30 + 3 * ex * c.mu20 + ex * ex * ex * n;
+    s.mu21 = c.mu21 + ey * c.mu20 + 2 * ex * c.mu11 + ex * ex * ey * n;
+    s.mu12 = c.mu12 + ex * c.mu02 + 2 * ey * c.mu11 + ex * ey * ey * n;
+    s.mu03 = c.mu03 + 3 * ey * c.mu02 + ey * ey * ey * n;
+    return s;
+}
+
+void merge_tiled_components(std::vector<TiledComponent>& components, int a, int b) {
+    a = find_tiled_root(components, a);
+    b = find_tiled_root(components, b);
+    if (a == b) return;
+    TiledComponent& root = components[a];
+    const TiledComponent& other = components[b];
+    const double n_root = static_cast<double>(root.area), n_other = static_cast<double>(other.area);
+    const double n = n_root + n_other;
+    const double dx = other.meanX - root.meanX;
+    const double dy = other.meanY - root.meanY;
+    // Both parts' moments about the merged mean, which lies at fractions of (dx, dy) between them
+    const CentralMoments r = shift_central_moments(root.central, n_root, -dx * n_other / n, -dy * n_other / n);
+    const CentralMoments o = shift_central_moments(other.central, n_other, dx * n_root / n, dy * n_root / n);
+    root.central.mu20 = r.mu20 + o.mu20;
+    root.central.mu11 = r.mu11 + o.mu11;
+    root.central.mu02 = r.mu02 + o.mu02;
+    root.central.mu30 = r.mu30 + o.mu30;
+    root.central.mu21 = r.mu21 + o.mu21;
+    root.central.mu12 = r.mu12 + o.mu12;
+    root.central.mu03 = r.mu03 + o.mu03;
+    root.meanX += dx * n_other / n;
+    root.meanY += dy * n_other / n;
+    root.quadSum += other.quadSum;
+    root.perimeter += other.perimeter;
+    root.area += other.area;
+    root.left = std::min(root.left, other.left);
+    root.top = std::min(root.top, other.top);
+    root.right = std::max(root.right, other.right);
+    root.bottom = std::max(root.bottom, other.bottom);
+    components[b].parent = a;
+}
+
+Region tiled_component_region(const TiledComponent& c, const cv::Size& image) {
+    Region region;
+    region.area = static_cast<int>(std::min<long long>(c.area, std::numeric_limits<int>::max()));
+    region.boundingBox = cv::Rect(c.left, c.top, c.right - c.left + 1, c.bottom - c.top + 1);
+    region.centroid = cv::Point2d(c.meanX, c.meanY);
+    region.aspectRatio = static_cast<double>(region.boundingBox.width) / region.boundingBox.height;
+    region.touchesBoundary = c.left <= 0 || c.top <= 0 || c.right >= image.width - 1 || c.bottom >= image.height - 1;
+    region.percentFilled = static_cast<double>(c.area) /
+                           (static_cast<double>(region.boundingBox.width) * region.boundingBox.height);
+    region.leastCentralMomentAxis = c.central.axis();
+    c.central.huMoments(static_cast<double>(c.area), region.huMoments);
+    region.eulerNumber = c.quadSum / 4;
+    region.holes = 1 - region.eulerNumber;
+    region.perimeter = static_cast<int>(std::min<long long>(c.perimeter, std::numeric_limits<int>::max()));
+    region.compactness = region_compactness(static_cast<double>(c.area), static_cast<double>(c.perimeter));
+    region.color = cv::Vec3b(0, 0, 0);
+    return region;
+}
+
+} // namespace
+
+RegionBatch extract_regions_tiled(TiledImageReader& reader, const PipelineOptions& options,
+                                  int min_region_size, int tile_size) {
+    const cv::Size size = reader.getSize();
+    const cv::Rect image(0, 0, size.width, size.height);
+    const int halo = segmentation_halo(options);
+
+    std::vector<TiledComponent> components;
+    RegionBatch regions;
+    // Component of every pixel in the bottom row of the previous and the current row of
+    // tiles, and in the right column of the previous tile; -1 for background
+    std::vector<int> above(size.width, -1);
+    std::vector<int> bottom(size.width, -1);
+    std::vector<int> left(tile_size, -1);
+
+    for (int y0 = 0; y0 < size.height; y0 += tile_size) {
+        for (int x0 = 0; x0 < size.width; x0 += tile_size) {
+            const cv::Rect out = cv::Rect(x0, y0, tile_size, tile_size) & image;
+            const cv::Rect in = cv::Rect(out.x - halo, out.y - halo, out.width + 2 * halo, out.height + 2 * halo) & image;
+            cv::Mat cleaned = segment_frame(reader.read(in), options)(
+                cv::Rect(out.x - in.x, out.y - in.y, out.width, out.height));
+
+            // The seam and quad passes read single labels through label_at, so the tile can
+            // use the 16-bit label image whenever its labels fit
+            cv::Mat labels, stats;
+            int num_labels = label_components(cleaned, &labels, stats);
+
+            LabelScan scan = label_statistics(labels, stats, num_labels, false, std::pmr::get_default_resource());
+
+            std::vector<int> ids(num_labels, -1);
+            for (int l = 1; l < num_labels; ++l) {
+                const RawMoments& m = scan.labels[l].moments;
+                const double n = static_cast<double>(m.m00);
+                TiledComponent c;
+                c.parent = static_cast<int>(components.size());
+                c.area = stats.at<int>(l, cv::CC_STAT_AREA);
+                c.left = out.x + stats.at<int>(l, cv::CC_STAT_LEFT);
+                c.top = out.y + stats.at<int>(l, cv::CC_STAT_TOP);
+                c.right = c.left + stats.at<int>(l, cv::CC_STAT_WIDTH) - 1;
+                c.bottom = c.top + stats.at<int>(l, cv::CC_STAT_HEIGHT) - 1;
+                c.meanX = c.left + m.m10 / n;
+                c.meanY = c.top + m.m01 / n;
+                c.central = m.central();
+                c.quadSum = 0;  // Counted below, once the seams are joined
+                c.perimeter = 0;
+                ids[l] = c.parent;
+                components.push_back(c);
+            }
+
+            // Join components across the seams, with 8-connectivity like the whole-image labeling
+            for (int x = 0; x < out.width && out.y > 0; ++x) {
+                const int l = label_at(labels, 0, x);
+                if (l == 0) continue;
+                for (int nx = std::max(0, out.x + x - 1); nx <= std::min(size.width - 1, out.x + x + 1); ++nx) {
+                    if (above[nx] >= 0) merge_tiled_components(components, ids[l], above[nx]);
+                }
+            }
+            for (int y = 0; y < out.height && out.x > 0; ++y) {
+                const int l = label_at(labels, y, 0);
+                if (l == 0) continue;
+                for (int ny = std::max(0, y - 1); ny <= std::min(out.height - 1, y + 1); ++ny) {
+                    if (left[ny] >= 0) merge_tiled_components(components, ids[l], left[ny]);
+                }
+            }
+
+            // Bit-quads whose bottom-right pixel is in this tile, or in the padding past the
+            // image's last row and column. Quads on the seams read the pixels above and to the
+            // left from the previous tiles, so every quad of the image is counted exactly once.
+            // The cracks are counted on the quads as in label_statistics.
+            auto component_at = [&](int x, int y) {
+                if (x < 0 || y < 0 || x >= size.width || y >= size.height) return -1;
+                if (y < out.y) return above[x];
+                if (x < out.x) return left[y - out.y];
+                return ids[label_at(labels, y - out.y, x - out.x)];
+            };
+            const int quad_x_end = out.x + out.width + (out.x + out.width == size.width ? 1 : 0);
+            const int quad_y_end = out.y + out.height + (out.y + out.height == size.height ? 1 : 0);
+            for (int qy = out.y; qy < quad_y_end; ++qy) {
+                for (int qx = out.x; qx < quad_x_end; ++qx) {
+                    const int a = component_at(qx - 1, qy - 1);
+                    const int b = component_at(qx, qy - 1);
+                    const int c = component_at(qx - 1, qy);
+                    const int d = component_at(qx, qy);
+                    const int weight = kQuadWeight[(a >= 0) | (b >= 0) << 1 | (c >= 0) << 2 | (d >= 0) << 3];
+                    if (weight != 0) {
+                        components[find_tiled_root(components, a >= 0 ? a : b >= 0 ? b : c >= 0 ? c : d)].quadSum += weight;
+                    }
+                    if ((b >= 0) != (d >= 0)) {
+                        components[find_tiled_root(components, b >= 0 ? b : d)].perimeter++;
+                    }
+                    if ((c >= 0) != (d >= 0)) {
+                        components[find_tiled_root(components, c >= 0 ? c : d)].perimeter++;
+                    }
+                }
+            }
+
+            for (int x = 0; x < out.width; ++x) {
+                bottom[out.x + x] = ids[label_at(labels, out.height - 1, x)];
+            }
+            for (int y = 0; y < out.height; ++y) {
+                left[y] = ids[label_at(labels, y, out.width - 1)];
+            }
+        }
+
+        // Components that do not reach the bottom row of this row of tiles are complete.
+        // Only the open ones are carried over, renumbered, so memory does not grow with the
+        // image height.
+        std::vector<int> renumbered(components.size(), -1);
+        std::vector<TiledComponent> open;
+        for (int& id : bottom) {
+            if (id < 0) continue;
+            const int root = find_tiled_root(components, id);
+            if (renumbered[root] < 0) {
+                renumbered[root] = static_cast<int>(open.size());
+                open.push_back(components[root]);
+                open.back().parent = renumbered[root];
+            }
+            id = renumbered[root];
+        }
+        for (size_t i = 0; i < components.size(); ++i) {
+            if (components[i].parent == static_cast<int>(i) && renumbered[i] < 0 &&
+                components[i].area >= min_region_size) {
+                regions.add(tiled_component_region(components[i], size));
+            }
+        }
+        components.swap(open);
+        above.swap(bottom);
+        std::fill(bottom.begin(), bottom.end(), -1);
+    }
+
+    for (size_t i = 0; i < components.size(); ++i) {
+        if (components[i].area >= min_region_size) {
+            regions.add(tiled_component_region(components[i], size));
+        }
+    }
+    regions.sortByAreaDescending();
+    return regions;
+}
+
+std::pmr::vector<cv::Rect> IncrementalSegmenter::resegmentTiles(const cv::Mat& frame, const FrameChangeGate& gate,
+                                                                 std::pmr::memory_resource* memory) {
+    const cv::Rect image(0, 0, frame.cols, frame.rows);
+
+    if (options.threshold_method == ThresholdMethod::Background) {
+        cleaned = background.segment(frame, &thresholded);
+        return std::pmr::vector<cv::Rect>(1, image, memory);
+    }
+
+    std::pmr::vector<cv::Rect> changed(memory);
+    const std::vector<uchar>& flags = gate.changedTiles();
+    const bool full = cleaned.empty() || cleaned.size() != frame.size() ||
+                      gate.tilesX() * gate.getTileSize() < frame.cols ||
+                      gate.tilesY() * gate.getTileSize() < frame.rows ||
+                      std::all_of(flags.begin(), flags.end(), [](uchar f) { return f != 0; });
+    if (full && options.coarse_to_fine) {
+        // Every old component is gone; a size mismatch makes relabel start from scratch
+        componentIds.release();
+        std::vector<cv::Rect> dirty;
+        cleaned = segment_frame_coarse_to_fine(frame, options, minRegionSize, &thresholded, &dirty);
+        return std::pmr::vector<cv::Rect>(dirty.begin(), dirty.end(), memory);
+    }
+    if (full) {
+        thresholded.create(frame.rows, frame.cols, CV_8UC1);
+        cleaned.create(frame.rows, frame.cols, CV_8UC1);
+        changed.push_back(image);
+    } else {
+        // Merge horizontal runs of changed tiles into one rectangle each
+        const int tile = gate.getTileSize();
+        for (int ty = 0; ty < gate.tilesY(); ++ty) {
+            for (int tx = 0; tx < gate.tilesX(); ++tx) {
+                if (!flags[ty * gate.tilesX() + tx]) continue;
+                int run_end = tx;
+                while (run_end + 1 < gate.tilesX() && flags[ty * gate.tilesX() + run_end + 1]) {
+                    run_end++;
+                }
+                changed.push_back(cv::Rect(tx * tile, ty * tile, (run_end - tx + 1) * tile, tile) & image);
+                tx = run_end;
+            }
+        }
+    }
+
+    std::pmr::vector<cv::Rect> dirty(memory);
+    dirty.reserve(changed.size());
+    for (const cv::Rect& rect : changed) {
+        dirty.push_back(segment_rect(frame, options, rect, cleaned, thresholded));
+    }
+    return dirty;
+}
+
+void IncrementalSegmenter::relabel(const std::pmr::vector<cv::Rect>& dirty, std::pmr::memory_resource* memory) {
+    const cv::Rect image(0, 0, cleaned.cols, cleaned.rows);
+    if (componentIds.size() != cleaned.size()) {
+        componentIds = cv::Mat::zeros(cleaned.rows, cleaned.cols, CV_32S);
+        components.assign(1, Component());
+        freeIds.clear();
+    }
+
+    // A component whose box touches a dirty rectangle, or is next to one, may have grown,
+    // shrunk, split or merged; it is dropped and rebuilt from the new mask. The dirty area and
+    // those components are grouped into windows that do not touch each other, so every rebuilt
+    // component fits inside one window and each window is labeled on its own.
+    std::pmr::vector<cv::Rect> windows(dirty.begin(), dirty.end(), memory);
+    std::pmr::vector<uchar> dropped(components.size(), 0, memory);
+    for (size_t id = 1; id < components.size(); ++id) {
+        Component& component = components[id];
+        component.fresh = false;
+        if (!component.alive) continue;
+        const cv::Rect& box = component.region.boundingBox;
+        const cv::Rect grown(box.x - 1, box.y - 1, box.width + 2, box.height + 2);
+        for (const cv::Rect& rect : dirty) {
+            if ((grown & rect).area() > 0) {
+                dropped[id] = 1;
+                windows.push_back(box);
+                break;
+            }
+        }
+    }
+    merge_rects(windows);
+
+    for (size_t id = 1; id < components.size(); ++id) {
+        if (dropped[id]) {
+            components[id].alive = false;
+            freeIds.push_back(static_cast<int>(id));
+        }
+    }
+
+    for (const cv::Rect& rect : windows) {
+        relabelWindow(rect & image, dirty, dropped, memory);
+    }
+}
+
+// For each label of a relabeled window, whether it reaches into the dirty mask and the old
+// component id of its first pixel.
+template <typename Label>
+static void match_window_labels(const cv::Mat& labels, const cv::Mat& dirty_mask, const cv::Mat& old_ids,
+                                std::pmr::vector<int>& touches_dirty, std::pmr::vector<int>& old_id) {
+    for (int y = 0; y < labels.rows; ++y) {
+        const Label* row = labels.ptr<Label>(y);
+        const uchar* mask = dirty_mask.ptr<uchar>(y);
+        const int* ids = old_ids.ptr<int>(y);
+        for (int x = 0; x < labels.cols; ++x) {
+            const int l = row[x];
+            if (l == 0) continue;
+            touches_dirty[l] |= mask[x];
+            if (old_id[l] < 0) old_id[l] = ids[x];
+        }
+    }
+}
+
+// Writes the new component ids of a relabeled window; labels without one keep their old id.
+template <typename Label>
+static void write_window_ids(const cv::Mat& labels, const std::pmr::vector<int>& new_id, cv::Mat& ids) {
+    for (int y = 0; y < labels.rows; ++y) {
+        const Label* row = labels.ptr<Label>(y);
+        int* out = ids.ptr<int>(y);
+        for (int x = 0; x < labels.cols; ++x) {
+            if (row[x] == 0) {
+                out[x] = 0;
+            } else if (new_id[row[x]] >= 0) {
+                out[x] = new_id[row[x]];
+            }
+        }
+    }
+}
+
+void IncrementalSegmenter::relabelWindow(const cv::Rect& window, const std::pmr::vector<cv::Rect>& dirty,
+                                         const std::pmr::vector<uchar>& dropped, std::pmr::memory_resource* memory) {
+    if (window.area() == 0) return;
+
+    cv::Mat dirty_mask = cv::Mat::zeros(window.height, window.width, CV_8UC1);
+    for (const cv::Rect& rect : dirty) {
+        const cv::Rect part = rect & window;
+        if (part.area() == 0) continue;
+        dirty_mask(cv::Rect(part.x - window.x, part.y - window.y, part.width, part.height)).setTo(1);
+    }
+
+    cv::Mat labels, stats;
+    int num_labels = label_components(cleaned(window), &labels, stats, memory);
+
+    // Keep the components that reach into the dirty area or belong to a dropped component.
+    // Anything else in the window is part of an untouched component and keeps its old id.
+    std::pmr::vector<int> touches_dirty(num_labels, 0, memory);
+    std::pmr::vector<int> old_id(num_labels, -1, memory);
+    if (labels.depth() == CV_16U) {
+        match_window_labels<ushort>(labels, dirty_mask, componentIds(window), touches_dirty, old_id);
+    } else {
+        match_window_labels<int>(labels, dirty_mask, componentIds(window), touches_dirty, old_id);
+    }
+
+    LabelScan scan = label_statistics(labels, stats, num_labels, computeOrientedBox, memory);
+    std::pmr::vector<int> new_id(num_labels, -1, memory);
+    for (int l = 1; l < num_labels; ++l) {
+        if (!touches_dirty[l] && !dropped[old_id[l]]) continue;
+
+        int id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+        } else {
+            id = static_cast<int>(components.size());
+            components.emplace_back();
+        }
+        cv::Rect box(stats.at<int>(l, cv::CC_STAT_LEFT) + window.x, stats.at<int>(l, cv::CC_STAT_TOP) + window.y,
+                     stats.at<int>(l, cv::CC_STAT_WIDTH), stats.at<int>(l, cv::CC_STAT_HEIGHT));
+        Component& component = components[id];
+        component.region = describe_region(cleaned, box, scan, l, computeOrientedBox, memory);
+        component.label.clear();
+        component.alive = true;
+        component.fresh = true;
+        new_id[l] = id;
+    }
+
+    cv::Mat window_ids = componentIds(window);
+    if (labels.depth() == CV_16U) {
+        write_window_ids<ushort>(labels, new_id, window_ids);
+    } else {
+        write_window_ids<int>(labels, new_id, window_ids);
+    }
+}
+
+void IncrementalSegmenter::update(const cv::Mat& frame, const FrameChangeGate& gate,
+                                  std::pmr::memory_resource* memory) {
+    std::pmr::vector<cv::Rect> dirty = resegmentTiles(frame, gate, memory);
+    relabel(dirty, memory);
+
+    regions.clear();
+    regionIds.clear();
+    std::pmr::vector<int> ids(memory);
+    for (size_t id = 1; id < components.size(); ++id) {
+        if (components[id].alive && components[id].region.area >= minRegionSize) {
+            ids.push_back(static_cast<int>(id));
+        }
+    }
+    std::sort(ids.begin(), ids.end(), [&](int a, int b) {
+        return components[a].region.area > components[b].region.area;
+    });
+    for (int id : ids) {
+        regions.add(components[id].region);
+        regionIds.push_back(id);
+        if (components[id].fresh) {
+            regionsRecomputed++;
+        } else {
+            regionsReused++;
+        }
+    }
+
+    double area = 0;
+    for (const cv::Rect& rect : dirty) {
+        area += rect.area();
+    }
+    framesUpdated++;
+    recomputedPixels += std::min(area, static_cast<double>(frame.total()));
+    totalPixels += static_cast<double>(frame.total());
+}
+
+std::string IncrementalSegmenter::summary() const {
+    std::ostringstream out;
+    double pixel_percent = totalPixels > 0 ? 100.0 * recomputedPixels / totalPixels : 0.0;
+    long regions_seen = regionsRecomputed + regionsReused;
+    double region_percent = regions_seen > 0 ? 100.0 * regionsReused / regions_seen : 0.0;
+    out << "Incremental update: recomputed " << std::fixed << std::setprecision(1) << pixel_percent
+        << "% of pixels over " << framesUpdated << " frames, reused " << region_percent << "% of regions";
+    return out.str();
+}
+
+int StreamingLabeler::newComponent(int x0, int x1) {
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<int>(components.size());
+        components.emplace_back();
+        continued.push_back(0);
+    }
+    Component& c = components[slot];
+    c.parent = slot;
+    c.top = c.bottom = rowsSeen;
+    c.left = x0;
+    c.right = x1;
+    c.moments = RawMoments();
+    c.moments.addRun(0, x1 - x0, 0);  // The run is on row 0 and starts the component's left column
+    c.eulerNumber = 1;
+    c.perimeter = 2 + 2 * static_cast<long long>(x1 - x0 + 1);  // Both ends, top and bottom
+    return slot;
+}
+
+int StreamingLabeler::findRoot(int slot) {
+    while (components[slot].parent != slot) {
+        components[slot].parent = components[components[slot].parent].parent;
+        slot = components[slot].parent;
+    }
+    return slot;
+}
+
+void StreamingLabeler::merge(int a, int b) {
+    a = findRoot(a);
+    b = findRoot(b);
+    if (a == b) return;
+    // Keep the component that started first as the root, and move the other one's moments
+    // to rows counted from the root's top and columns counted from the merged left edge
+    if (components[b].top < components[a].top) std::swap(a, b);
+    Component& root = components[a];
+    Component& child = components[b];
+    const int left = std::min(root.left, child.left);
+    if (left < root.left) {
+        RawMoments shifted;
+        shifted.add(root.moments, root.left - left, 0);
+        root.moments = shifted;
+    }
+    root.moments.add(child.moments, child.left - left, child.top - root.top);
+    root.eulerNumber += child.eulerNumber;
+    root.perimeter += child.perimeter;
+    root.bottom = std::max(root.bottom, child.bottom);
+    root.left = left;
+    root.right = std::max(root.right, child.right);
+    child.parent = a;
+}
+
+void StreamingLabeler::emit(const Component& c) {
+    if (c.moments.m00 < minRegionSize) return;
+    StreamedRegion streamed;
+    streamed.firstRow = c.top;
+    Region& region = streamed.region;
+    region.area = static_cast<int>(std::min<std::int64_t>(c.moments.m00, std::numeric_limits<int>::max()));
+    region.boundingBox = cv::Rect(c.left, 0, c.right - c.left + 1, static_cast<int>(c.bottom - c.top + 1));
+    const double m00 = static_cast<double>(c.moments.m00);
+    region.centroid = c.moments.centroid() + cv::Point2d(c.left, 0);
+    region.aspectRatio = static_cast<double>(region.boundingBox.width) / region.boundingBox.height;
+    region.touchesBoundary = c.left <= 0 || c.right >= width - 1 || c.top == 0;
+    region.percentFilled = m00 / (static_cast<double>(region.boundingBox.width) * region.boundingBox.height);
+    const CentralMoments central = c.moments.central();
+    region.leastCentralMomentAxis = central.axis();
+    central.huMoments(m00, region.huMoments);
+    region.eulerNumber = c.eulerNumber;
+    region.holes = 1 - c.eulerNumber;
+    region.perimeter = static_cast<int>(std::min<long long>(c.perimeter, std::numeric_limits<int>::max()));
+    region.compactness = region_compactness(m00, static_cast<double>(c.perimeter));
+    region.color = cv::Vec3b(0, 0, 0);
+    closed.push_back(streamed);
+}
+
+const std::vector<StreamedRegion>& StreamingLabeler::pushRow(const uchar* mask) {
+    closed.clear();
+    currentRuns.clear();
+    size_t prev = 0;
+    for (int x = 0; x < width;) {
+        if (!mask[x]) {
+            ++x;
+            continue;
+        }
+        const int x0 = x;
+        while (x < width && mask[x]) ++x;
+        const int x1 = x - 1;
+
+        // Previous runs that touch [x0 - 1, x1 + 1]; runs entirely to the left can never
+        // touch a later run of this row either
+        while (prev < previousRuns.size() && previousRuns[prev].x1 < x0 - 1) ++prev;
+        int slot = newComponent(x0, x1);
+        // Runs on consecutive rows never form a cycle, so every cycle of adjacent runs
+        // encloses a hole, and runs minus adjacent pairs is the 8-connectivity Euler number
+        for (size_t p = prev; p < previousRuns.size() && previousRuns[p].x0 <= x1 + 1; ++p) {
+            merge(previousRuns[p].component, slot);
+            Component& root = components[findRoot(slot)];
+            root.eulerNumber--;
+            // Columns shared with the run above lose the cracks between the two rows
+            const int overlap = std::min(x1, previousRuns[p].x1) - std::max(x0, previousRuns[p].x0) + 1;
+            if (overlap > 0) root.perimeter -= 2 * overlap;
+        }
+        currentRuns.push_back({x0, x1, slot});
+    }
+
+    // The components reached by this row stay open; any other component that was open after
+    // the previous row ended on it. Slots merged into another component are recycled.
+    createdSlots.clear();
+    nextLiveSlots.clear();
+    for (Run& run : currentRuns) {
+        createdSlots.push_back(run.component);
+        run.component = findRoot(run.component);
+        if (!continued[run.component]) {
+            continued[run.component] = 1;
+            nextLiveSlots.push_back(run.component);
+        }
+    }
+    for (int slot : liveSlots) {
+        if (continued[slot]) continue;
+        if (components[slot].parent == slot) {
+            emit(components[slot]);
+        }
+        freeSlots.push_back(slot);
+    }
+    for (int slot : createdSlots) {
+        if (!continued[slot]) {
+            freeSlots.push_back(slot);
+        }
+    }
+    for (int slot : nextLiveSlots) {
+        continued[slot] = 0;
+    }
+    liveSlots.swap(nextLiveSlots);
+    previousRuns.swap(currentRuns);
+    rowsSeen++;
+    return closed;
+}
+
+const std::vector<StreamedRegion>& StreamingLabeler::finish() {
+    closed.clear();
+    for (int slot : liveSlots) {
+        emit(components[slot]);
+    }
+    components.clear();
+    continued.clear();
+    freeSlots.clear();
+    liveSlots.clear();
+    previousRuns.clear();
+    return closed;
+}
+
+void draw_region_information(cv::Mat& output, const RegionBatch& regions, size_t i, const cv::Vec3b& color) {
+    const cv::Rect& box = regions.boundingBox[i];
+    const cv::Point2d centroid(regions.centroidX[i], regions.centroidY[i]);
+
+    // Draw bounding box
+    cv::rectangle(output, box, color, 2);
+
+    // Draw centroid
+    cv::circle(output, cv::Point(centroid.x, centroid.y), 4, color, -1);
+
+    // Draw region information
+    std::string areaText = "Area: " + std::to_string(regions.area[i]);
+    std::string aspectText = "AR: " + std::to_string(static_cast<int>(regions.aspectRatio[i] * 100) / 100.0);
+    std::string percentFilledText = "Filled: " + std::to_string(static_cast<int>(regions.percentFilled[i] * 100)) + "%";
+
+    cv::putText(output, areaText,
+                cv::Point(box.x, box.y - 5),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 1);
+    cv::putText(output, aspectText,
+                cv::Point(box.x, box.y - 20),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 1);
+    cv::putText(output, percentFilledText,
+                cv::Point(box.x, box.y - 35),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 1);
+
+    // Draw least central moment axis
+    double angle = regions.leastCentralMomentAxis[i];
+    double length = std::min(box.width, box.height) / 2.0;
+    cv::Point2d start(centroid.x - length * std::cos(angle), centroid.y - length * std::sin(angle));
+    cv::Point2d end(centroid.x + length * std::cos(angle), centroid.y + length * std::sin(angle));
+    cv::line(output, start, end, color, 2);
+
+    // Draw oriented bounding box, if one was computed
+    if (regions.orientedBoundingBox[i].size.area() > 0) {
+        cv::Point2f vertices[4];
+        regions.orientedBoundingBox[i].points(vertices);
+        for (int k = 0; k < 4; ++k) {
+            cv::line(output, vertices[k], vertices[(k + 1) % 4], color, 2);
+        }
+    }
+}
+
+cv::Mat visualize_regions(const cv::Mat& original, const cv::Mat& labels,
+                          const RegionBatch& regions,
+                          RegionTracker& tracker, int max_regions, std::pmr::memory_resource* memory) {
+    cv::Mat output = original.clone();
+    std::pmr::vector<int> processedRegions(memory);
+
+    int processed_count = 0;
+    for (size_t i = 0; i < regions.size(); ++i) {
+        if (processed_count >= max_regions || regions.touchesBoundary[i]) {
+            continue;
+        }
+
+        cv::Vec3b color = tracker.getRegionColor(regions, i);
+        draw_region_information(output, regions, i, color);
+
+        regions.color[i] = color;
+        processedRegions.push_back(static_cast<int>(i));
+
+        processed_count++;
+    }
+
+    tracker.updateRegions(regions, processedRegions);
+    return output;
+}
+
+double hu_feature(double hu) {
+    return hu == 0.0 ? 0.0 : -std::copysign(std::log10(std::abs(hu)), hu);
+}
+
+FeatureVector make_feature_vector(const Region& region, const std::string& label) {
+    FeatureVector fv{label, std::vector<double>(FeatureCount)};
+    fv.values[FeatureArea] = region.area;
+    fv.values[FeatureAspectRatio] = region.aspectRatio;
+    fv.values[FeaturePercentFilled] = region.percentFilled;
+    fv.values[FeatureAxis] = region.leastCentralMomentAxis;
+    fv.values[FeatureHoles] = region.holes;
+    fv.values[FeaturePerimeter] = region.perimeter;
+    fv.values[FeatureCompactness] = region.compactness;
+    for (int k = 0; k < 7; ++k) {
+        fv.values[FeatureHu1 + k] = hu_feature(region.huMoments[k]);
+    }
+    return fv;
+}
+
+// Writes the FeatureCount features of region i in FeatureIndex order.
+static void batch_features(const RegionBatch& regions, size_t i, double* values) {
+    values[FeatureArea] = regions.area[i];
+    values[FeatureAspectRatio] = regions.aspectRatio[i];
+    values[FeaturePercentFilled] = regions.percentFilled[i];
+    values[FeatureAxis] = regions.leastCentralMomentAxis[i];
+    values[FeatureHoles] = regions.holes[i];
+    values[FeaturePerimeter] = regions.perimeter[i];
+    values[FeatureCompactness] = regions.compactness[i];
+    for (int k = 0; k < 7; ++k) {
+        values[FeatureHu1 + k] = hu_feature(regions.huMoments[k][i]);
+    }
+}
+
+FeatureVector make_feature_vector(const RegionBatch& regions, size_t i, const std::string& label) {
+    FeatureVector fv{label, std::vector<double>(FeatureCount)};
+    batch_features(regions, i, fv.values.data());
+    return fv;
+}
+
+static const char kDimensionHeader[] = "#dimension,";
+
+// Returns the dimension given by a "#dimension,N" header line, or 0 if the line is not one.
+static int parse_dimension_header(const std::string& line) {
+    if (line.compare(0, sizeof(kDimensionHeader) - 1, kDimensionHeader) != 0) {
+        return 0;
+    }
+    return std::max(0, std::atoi(line.c_str() + sizeof(kDimensionHeader) - 1));
+}
+
+// Parses a "label,value,value,..." row. Rows of files written before the dimension header have
+// an Euler number column before the hole count, which is dropped.
+static bool parse_feature_row(const std::string& line, bool legacy, FeatureVector& fv) {
+    std::stringstream ss(line);
+    std::getline(ss, fv.label, ',');
+    double value;
+    while (ss >> value) {
+        fv.values.push_back(value);
+        if (ss.peek() != ',') break;
+        ss.ignore(1);
+    }
+    if (legacy && fv.dimension() > FeatureHoles) {
+        fv.values.erase(fv.values.begin() + FeatureHoles);
+    }
+    return !fv.values.empty();
+}
+
+void save_feature_vector(const std::string& filename, const RegionBatch& regions, size_t i, const std::string& label) {
+    // An existing database keeps its dimension, and the layout of its first row when it has
+    // no header
+    int dimension = FeatureCount;
+    bool new_file = true, legacy = false;
+    {
+        std::ifstream existing(filename);
+        std::string first;
+        if (existing.is_open() && std::getline(existing, first) && !first.empty()) {
+            new_file = false;
+            FeatureVector first_fv;
+            if (int header = parse_dimension_header(first)) {
+                dimension = header;
+            } else if (parse_feature_row(first, true, first_fv)) {
+                dimension = first_fv.dimension();
+                legacy = true;
+            }
+        }
+    }
+
+    std::ofstream file(filename, std::ios::app);
+    if (file.is_open()) {
+        const FeatureVector fv = make_feature_vector(regions, i, label);
+        // 9 significant digits round-trip the float features and keep pixel counts exact
+        file << std::setprecision(9);
+        if (new_file) {
+            file << kDimensionHeader << dimension << "\n";
+        }
+        file << label;
+        for (int k = 0; k < std::min(dimension, fv.dimension()); ++k) {
+            if (legacy && k == FeatureHoles) {
+                file << "," << 1 - fv.values[FeatureHoles];  // Euler number column
+            }
+            file << "," << fv.values[k];
+        }
+        file << "\n";
+        file.close();
+    } else {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+    }
+}
+
+std::vector<FeatureVector> load_known_objects(const std::string& filename) {
+    std::vector<FeatureVector> known_objects;
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return known_objects;
+    }
+
+    int dimension = 0;
+    bool legacy = true;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        if (line.empty() || line == "\r") continue;
+        if (line_number == 1 && line[0] == '#') {
+            dimension = parse_dimension_header(line);
+            if (dimension <= 0) {
+                std::cerr << "Error: Invalid dimension header in " << filename << std::endl;
+                return known_objects;
+            }
+            legacy = false;
+            continue;
+        }
+
+        FeatureVector fv;
+        if (!parse_feature_row(line, legacy, fv)) {
+            std::cerr << "Warning: Skipping malformed row " << line_number << " of " << filename << std::endl;
+            continue;
+        }
+        if (dimension == 0) {
+            dimension = fv.dimension();
+        }
+        if (fv.dimension() < dimension) {
+            std::cerr << "Warning: Skipping row " << line_number << " of " << filename << " with "
+                      << fv.dimension() << " of " << dimension << " features" << std::endl;
+            continue;
+        }
+        fv.values.resize(dimension);
+        known_objects.push_back(std::move(fv));
+    }
+
+    file.close();
+    return known_objects;
+}
+
+namespace {
+
+// Per-feature terms of the distance metrics: term() is added up over the features and
+// finish() turns the sum into the distance.
+struct ScaledEuclideanTerms {
+    static double term(double a, double b, double stdev) {
+        const double d = (a - b) / stdev;
+        return d * d;
+    }
+    static double finish(double sum) { return std::sqrt(sum); }
+};
+
+struct EuclideanTerms {
+    static double term(double a, double b, double) {
+        const double d = a - b;
+        return d * d;
+    }
+    static double finish(double sum) { return std::sqrt(sum); }
+};
+
+struct ManhattanTerms {
+    static double term(double a, double b, double) { return std::abs(a - b); }
+    static double finish(double sum) { return sum; }
+};
+
+// Distance over exactly D features, so the loop unrolls.
+template <typename Terms, int D>
+double fixed_feature_distance(const double* a, const double* b, const double* stdevs) {
+    double sum = 0.0;
+    for (int k = 0; k < D; ++k) {
+        sum += Terms::term(a[k], b[k], stdevs ? stdevs[k] : 1.0);
+    }
+    return Terms::finish(sum);
+}
+
+// Distance over the first `dimension` features. The unscaled metrics take no stdevs.
+template <typename Terms>
+double feature_distance(const double* a, const double* b, const double* stdevs, int dimension) {
+    switch (dimension) {
+        case 4:
+            return fixed_feature_distance<Terms, 4>(a, b, stdevs);
+        case 8:
+            return fixed_feature_distance<Terms, 8>(a, b, stdevs);
+        case 16:
+            return fixed_feature_distance<Terms, 16>(a, b, stdevs);
+        default: {
+            double sum = 0.0;
+            for (int k = 0; k < dimension; ++k) {
+                sum += Terms::term(a[k], b[k], stdevs ? stdevs[k] : 1.0);
+            }
+            return Terms::finish(sum);
+        }
+    }
+}
+
+// For each packed query row, the index of the nearest packed known row, in the order
+// classify_feature_vector compares them. Rows are `width` values apart.
+template <typename Terms>
+void nearest_known_rows(const std::pmr::vector<double>& queries, const std::vector<double>& known,
+                        const double* stdevs, int width, std::pmr::vector<int>& best_object) {
+    const size_t n = best_object.size();
+    const size_t objects = known.size() / width;
+    std::pmr::vector<double> best(n, std::numeric_limits<double>::max(), best_object.get_allocator().resource());
+    for (size_t o = 0; o < objects; ++o) {
+        const double* row = known.data() + o * width;
+        for (size_t k = 0; k < n; ++k) {
+            const double distance = feature_distance<Terms>(queries.data() + k * width, row, stdevs, width);
+            if (distance < best[k]) {
+                best[k] = distance;
+                best_object[k] = static_cast<int>(o);
+            }
+        }
+    }
+}
+
+}  // namespace
+
+double compute_scaled_euclidean_distance(const FeatureVector& fv1, const FeatureVector& fv2,
+                                         const std::vector<double>& stdevs) {
+    const int dimension = std::min({fv1.dimension(), fv2.dimension(), static_cast<int>(stdevs.size())});
+    return feature_distance<ScaledEuclideanTerms>(fv1.values.data(), fv2.values.data(), stdevs.data(), dimension);
+}
+
+double compute_euclidean_distance(const FeatureVector& fv1, const FeatureVector& fv2) {
+    const int dimension = std::min(fv1.dimension(), fv2.dimension());
+    return feature_distance<EuclideanTerms>(fv1.values.data(), fv2.values.data(), nullptr, dimension);
+}
+
+double compute_manhattan_distance(const FeatureVector& fv1, const FeatureVector& fv2) {
+    const int dimension = std::min(fv1.dimension(), fv2.dimension());
+    return feature_distance<ManhattanTerms>(fv1.values.data(), fv2.values.data(), nullptr, dimension);
+}
+
+double compute_feature_distance(const FeatureVector& fv1, const FeatureVector& fv2, const std::vector<double>& stdevs,
+                                DistanceMetric metric) {
+    switch (metric) {
+        case DistanceMetric::ScaledEuclidean:
+            return compute_scaled_euclidean_distance(fv1, fv2, stdevs);
+        case DistanceMetric::Manhattan:
+            return compute_manhattan_distance(fv1, fv2);
+        default:
+            return compute_euclidean_distance(fv1, fv2);
+    }
+}
+
+std::vector<double> compute_feature_stdevs(const std::vector<FeatureVector>& known_objects) {
+    if (known_objects.empty()) {
+        return {};
+    }
+    int dimension = known_objects[0].dimension();
+    for (const auto& fv : known_objects) {
+        dimension = std::min(dimension, fv.dimension());
+    }
+
+    std::vector<double> means(dimension, 0.0);
+    std::vector<double> stdevs(dimension, 0.0);
+
+    for (const auto& fv : known_objects) {
+        for (int k = 0; k < dimension; ++k) {
+            means[k] += fv.values[k];
+        }
+    }
+
+    for (auto& mean : means) {
+        mean /= known_objects.size();
+    }
+
+    for (const auto& fv : known_objects) {
+        for (int k = 0; k < dimension; ++k) {
+            stdevs[k] += std::pow(fv.values[k] - means[k], 2);
+        }
+    }
+
+    for (auto& stdev : stdevs) {
+        stdev = std::sqrt(stdev / known_objects.size());
+        if (!(stdev > 0.0)) {
+            stdev = 1.0;
+        }
+    }
+
+    return stdevs;
+}
+
+std::vector<FeatureVector> class_prototypes(const std::vector<FeatureVector>& known_objects,
+                                            const std::vector<double>& stdevs, int per_class) {
+    std::vector<FeatureVector> prototypes;
+    if (known_objects.empty() || per_class <= 0) {
+        return prototypes;
+    }
+    int dimension = static_cast<int>(stdevs.size());
+    for (const auto& fv : known_objects) {
+        dimension = std::min(dimension, fv.dimension());
+    }
+
+    // Members of each label, in order of first appearance
+    std::map<std::string, int> class_of;
+    std::vector<std::vector<int>> members;
+    for (size_t o = 0; o < known_objects.size(); ++o) {
+        auto inserted = class_of.emplace(known_objects[o].label, static_cast<int>(members.size()));
+        if (inserted.second) {
+            members.emplace_back();
+        }
+        members[inserted.first->second].push_back(static_cast<int>(o));
+    }
+    std::vector<std::string> labels(members.size());
+    for (const auto& entry : class_of) {
+        labels[entry.second] = entry.first;
+    }
+
+    auto distance = [&](const std::vector<double>& a, const std::vector<double>& b) {
+        return feature_distance<ScaledEuclideanTerms>(a.data(), b.data(), stdevs.data(), dimension);
+    };
+    std::mt19937 rng(12345);
+    for (size_t c = 0; c < members.size(); ++c) {
+        const std::vector<int>& objects = members[c];
+        std::vector<std::vector<double>> points(objects.size());
+        for (size_t i = 0; i < objects.size(); ++i) {
+            const auto& values = known_objects[objects[i]].values;
+            points[i].assign(values.begin(), values.begin() + dimension);
+        }
+        if (static_cast<int>(points.size()) <= per_class) {
+            for (auto& point : points) {
+                prototypes.push_back({labels[c], std::move(point)});
+            }
+            continue;
+        }
+
+        // k-means++ seeding: each further center is drawn with probability proportional to
+        // the squared distance to the nearest center so far
+        const int k = std::min(per_class, static_cast<int>(points.size()));
+        std::vector<std::vector<double>> centers;
+        std::vector<double> nearest(points.size(), std::numeric_limits<double>::max());
+        centers.push_back(points[std::uniform_int_distribution<size_t>(0, points.size() - 1)(rng)]);
+        while (static_cast<int>(centers.size()) < k) {
+            double total = 0.0;
+            for (size_t i = 0; i < points.size(); ++i) {
+                const double d = distance(points[i], centers.back());
+                nearest[i] = std::min(nearest[i], d * d);
+                total += nearest[i];
+            }
+            if (!(total > 0.0)) break;  // Fewer distinct points than k
+            double pick = std::uniform_real_distribution<double>(0.0, total)(rng);
+            size_t chosen = 0;
+            while (chosen + 1 < points.size() && pick >= nearest[chosen]) {
+                pick -= nearest[chosen++];
+            }
+            centers.push_back(points[chosen]);
+        }
+
+        // Lloyd iterations; one center is simply the class mean
+        std::vector<int> assignment(points.size(), -1);
+        for (int iteration = 0; iteration < 100; ++iteration) {
+            bool changed = false;
+            for (size_t i = 0; i < points.size(); ++i) {
+                int best = 0;
+                double best_distance = std::numeric_limits<double>::max();
+                for (size_t j = 0; j < centers.size(); ++j) {
+                    const double d = distance(points[i], centers[j]);
+                    if (d < best_distance) {
+                        best_distance = d;
+                        best = static_cast<int>(j);
+                    }
+                }
+                changed |= assignment[i] != best;
+                assignment[i] = best;
+            }
+            if (!changed) break;
+
+            std::vector<std::vector<double>> sums(centers.size(), std::vector<double>(dimension, 0.0));
+            std::vector<int> counts(centers.size(), 0);
+            for (size_t i = 0; i < points.size(); ++i) {
+                counts[assignment[i]]++;
+                for (int f = 0; f < dimension; ++f) {
+                    sums[assignment[i]][f] += points[i][f];
+                }
+            }
+            for (size_t j = 0; j < centers.size(); ++j) {
+                if (counts[j] == 0) continue;  // An emptied center stays where it was
+                for (int f = 0; f < dimension; ++f) {
+                    centers[j][f] = sums[j][f] / counts[j];
+                }
+            }
+        }
+        for (auto& center : centers) {
+            prototypes.push_back({labels[c], std::move(center)});
+        }
+    }
+    return prototypes;
+}
+
+std::string classify_feature_vector(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects,
+                                    const std::vector<double>& stdevs, DistanceMetric metric) {
+    double min_distance = std::numeric_limits<double>::max();
+    std::string best_label = "Unknown";
+
+    for (const auto& known_fv : known_objects) {
+        const double distance = compute_feature_distance(fv, known_fv, stdevs, metric);
+        if (distance < min_distance) {
+            min_distance = distance;
+            best_label = known_fv.label;
+        }
+    }
+
+    return best_label;
+}
+
+PackedFeatureDatabase::PackedFeatureDatabase(const std::vector<FeatureVector>& known_objects,
+                                             const std::vector<double>& stdevs, DistanceMetric metric)
+    : metric(metric), stdevs(stdevs) {
+    labels.reserve(known_objects.size());
+    for (const auto& known : known_objects) {
+        labels.push_back(known.label);
+    }
+    if (known_objects.empty()) {
+        return;
+    }
+
+    // The packed rows need one dimension for the whole database, which load_known_objects
+    // gives; anything else is kept as it is
+    for (const auto& known : known_objects) {
+        if (known.dimension() != known_objects[0].dimension()) {
+            unpacked = known_objects;
+            return;
+        }
+    }
+
+    // Rows are padded with zeros to the next fixed-size kernel. The padding adds exact zeros,
+    // so the distances match classify_feature_vector.
+    dimension = std::min(known_objects[0].dimension(), static_cast<int>(FeatureCount));
+    if (metric == DistanceMetric::ScaledEuclidean) {
+        dimension = std::min(dimension, static_cast<int>(stdevs.size()));
+    }
+    width = dimension <= 4 ? 4 : dimension <= 8 ? 8 : dimension <= 16 ? 16 : dimension;
+    rows.assign(known_objects.size() * width, 0.0);
+    for (size_t o = 0; o < known_objects.size(); ++o) {
+        const auto& values = known_objects[o].values;
+        std::copy(values.begin(), values.begin() + dimension, rows.begin() + o * width);
+    }
+    scale.assign(width, 1.0);
+    if (metric == DistanceMetric::ScaledEuclidean) {
+        std::copy(stdevs.begin(), stdevs.begin() + dimension, scale.begin());
+    }
+}
+
+const std::string& PackedFeatureDatabase::getLabel(int object) const {
+    static const std::string unknown = "Unknown";
+    return object >= 0 ? labels[object] : unknown;
+}
+
+std::pmr::vector<int> classify_regions(const RegionBatch& regions, const std::pmr::vector<int>& indices,
+                                       const PackedFeatureDatabase& database, std::pmr::memory_resource* memory) {
+    const size_t n = indices.size();
+    std::pmr::vector<int> best_object(n, -1, memory);
+    if (database.empty()) {
+        return best_object;
+    }
+
+    if (!database.unpacked.empty()) {
+        // Mixed dimensions: compare in the order classify_feature_vector does
+        for (size_t k = 0; k < n; ++k) {
+            const FeatureVector fv = make_feature_vector(regions, indices[k]);
+            double min_distance = std::numeric_limits<double>::max();
+            for (size_t o = 0; o < database.unpacked.size(); ++o) {
+                const double distance =
+                    compute_feature_distance(fv, database.unpacked[o], database.stdevs, database.metric);
+                if (distance < min_distance) {
+                    min_distance = distance;
+                    best_object[k] = static_cast<int>(o);
+                }
+            }
+        }
+        return best_object;
+    }
+
+    // Pack the regions straight from the batch columns into rows like the database's
+    const int width = database.width;
+    std::pmr::vector<double> queries(n * width, 0.0, memory);
+    double values[FeatureCount];
+    for (size_t k = 0; k < n; ++k) {
+        batch_features(regions, indices[k], values);
+        std::copy(values, values + database.dimension, queries.begin() + k * width);
+    }
+
+    switch (database.metric) {
+        case DistanceMetric::ScaledEuclidean:
+            nearest_known_rows<ScaledEuclideanTerms>(queries, database.rows, database.scale.data(), width, best_object);
+            break;
+        case DistanceMetric::Manhattan:
+            nearest_known_rows<ManhattanTerms>(queries, database.rows, nullptr, width, best_object);
+            break;
+        default:
+            nearest_known_rows<EuclideanTerms>(queries, database.rows, nullptr, width, best_object);
+            break;
+    }
+    return best_object;
+}
+
+std::vector<std::string> classify_regions(const RegionBatch& regions, const std::vector<int>& indices,
+                                          const std::vector<FeatureVector>& known_objects,
+                                          const std::vector<double>& stdevs, DistanceMetric metric) {
+    const PackedFeatureDatabase database(known_objects, stdevs, metric);
+    const std::pmr::vector<int> best_object =
+        classify_regions(regions, std::pmr::vector<int>(indices.begin(), indices.end()), database);
+    std::vector<std::string> labels;
+    labels.reserve(best_object.size());
+    for (int object : best_object) {
+        labels.push_back(database.getLabel(object));
+    }
+    return labels;
+}
@@ -0,0 +1,722 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: vision_core.h
+Purpose: Shared image-processing and classification core used by all task programs.
+It holds the region and feature structures, the thresholding / cleaning / region
+extraction pipeline, the region tracker, visualization helpers, and the feature
+database loading and distance functions. Hot pixel loops go through the
+CPU-dispatched kernels in vision_kernels.h.
+*/
+
+#ifndef VISION_CORE_H
+#define VISION_CORE_H
+
+#include <opencv2/opencv.hpp>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Structure to store region information
+struct Region {
+    cv::Point2d centroid;
+    mutable cv::Vec3b color;  // Mutable since it's just for visualization
+    int area;
+    cv::Rect boundingBox;
+    double aspectRatio;
+    bool touchesBoundary;
+    double percentFilled;
+    double leastCentralMomentAxis;
+    int eulerNumber;  // 1 minus the number of holes for a single connected region
+    int holes;
+    int perimeter;       // Pixel edges between the region and the background (crack length)
+    double compactness;  // 4 pi area / perimeter^2
+    double huMoments[7];  // Hu invariants, in cv::HuMoments order
+    cv::RotatedRect orientedBoundingBox;  // Only filled when extract_regions is asked for it
+    std::vector<cv::Point> convexHull;    // Pixel centers, filled along with the oriented box
+};
+
+// Central moments of a connected component up to third order: sums over its pixels of
+// (x - cx)^p (y - cy)^q, not divided by the area.
+struct CentralMoments {
+    double mu20 = 0, mu11 = 0, mu02 = 0;
+    double mu30 = 0, mu21 = 0, mu12 = 0, mu03 = 0;
+
+    // Angle of the least central moment axis.
+    double axis() const;
+
+    // Writes the seven Hu invariants of a component with the given area, in cv::HuMoments order.
+    void huMoments(double area, double hu[7]) const;
+};
+
+// Raw moments of a connected component as exact 64-bit integer sums, accumulated during the
+// labeling scan. Integer sums do not depend on the order pixels are added in, so the features
+// are the same for any scan order, thread count or ISA. Coordinates are relative to a corner
+// chosen by the caller, usually the component's bounding box, which keeps the sums small.
+struct RawMoments {
+    std::int64_t m00 = 0, m10 = 0, m01 = 0, m20 = 0, m11 = 0, m02 = 0;
+    std::int64_t m30 = 0, m21 = 0, m12 = 0, m03 = 0;  // Exact for components up to ~6000 pixels across
+
+    // Adds the run of pixels x0..x1 (inclusive) on row y.
+    void addRun(int x0, int x1, std::int64_t y);
+
+    // Adds another component's moments, with its coordinates moved by (dx, dy).
+    void add(const RawMoments& other, std::int64_t dx, std::int64_t dy);
+
+    // Centroid in the coordinates of the sums.
+    cv::Point2d centroid() const;
+
+    // Central moments derived from the raw sums.
+    CentralMoments central() const;
+
+    // Angle of the least central moment axis.
+    double axis() const { return central().axis(); }
+};
+
+// The regions of one frame as a structure of arrays: element i of every array describes
+// region i. Extraction fills it and the tracker, renderer and classifier read the arrays
+// directly, so per-frame work streams through contiguous feature columns instead of copying
+// padded Region structs. Features whose precision float covers are stored as float.
+class RegionBatch {
+public:
+    std::vector<int> area;
+    std::vector<cv::Rect> boundingBox;
+    std::vector<float> centroidX;
+    std::vector<float> centroidY;
+    std::vector<float> aspectRatio;
+    std::vector<float> percentFilled;
+    std::vector<float> leastCentralMomentAxis;
+    std::vector<uchar> touchesBoundary;
+    std::vector<int> eulerNumber;
+    std::vector<int> holes;
+    std::vector<int> perimeter;
+    std::vector<float> compactness;
+    std::array<std::vector<float>, 7> huMoments;  // huMoments[k][i] is Hu invariant k of region i
+    std::vector<cv::RotatedRect> orientedBoundingBox;  // Zero-sized unless extraction computed it
+    std::vector<std::vector<cv::Point>> convexHull;    // Empty unless extraction computed it
+    mutable std::vector<cv::Vec3b> color;              // Set during visualization
+
+    size_t size() const { return area.size(); }
+    bool empty() const { return area.empty(); }
+    void clear();
+    void reserve(size_t n);
+
+    // Appends one region.
+    void add(const Region& region);
+
+    // Returns region i as a Region struct, for code that handles one region at a time.
+    Region get(size_t i) const;
+
+    // Reorders every array so that the regions are sorted largest first. Scratch space comes
+    // from memory, and the arrays keep their own storage.
+    void sortByAreaDescending(std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+};
+
+// Order of the features in a FeatureVector. A database of dimension d uses the first d of
+// them: the original databases have the first four, and new ones are written with all of them.
+// The Euler number is left out since it is 1 minus the hole count. Hu invariants span many
+// orders of magnitude, so they are stored log-scaled (see hu_feature).
+enum FeatureIndex : int {
+    FeatureArea,
+    FeatureAspectRatio,
+    FeaturePercentFilled,
+    FeatureAxis,
+    FeatureHoles,
+    FeaturePerimeter,
+    FeatureCompactness,
+    FeatureHu1,
+    FeatureCount = FeatureHu1 + 7
+};
+
+// Structure to store feature vector and label
+struct FeatureVector {
+    std::string label;
+    std::vector<double> values;  // In FeatureIndex order; a database keeps the first `dimension`
+
+    int dimension() const { return static_cast<int>(values.size()); }
+};
+
+// Distance metrics supported by the nearest-neighbour classifier.
+enum class DistanceMetric {
+    Euclidean,
+    ScaledEuclidean,
+    Manhattan
+};
+
+// Adaptive threshold methods available to the segmentation pipeline.
+enum class ThresholdMethod {
+    Gaussian,  // cv::adaptiveThreshold with a Gaussian-weighted window
+    Mean,      // Box mean from sliding-window sums; cost does not depend on the block size
+    Background // Difference from a running background model; needs a BackgroundModel (fixed cameras)
+};
+
+// How the background model follows the scene.
+enum class BackgroundUpdate {
+    Average,  // Exponential running average
+    Median    // Approximate running median: one gray level per update towards the frame
+};
+
+// Pipeline settings shared by the task programs, set from optional --key=value flags.
+struct PipelineOptions {
+    ThresholdMethod threshold_method = ThresholdMethod::Gaussian;
+    int block_size = 11;
+    double threshold_offset = 2;
+    double change_threshold = 0;  // Frame gate: mean gray change per tile that counts as motion; 0 = off
+    int change_tile = 64;         // Frame gate tile size in pixels
+    bool coarse_to_fine = false;  // Full-resolution segmentation only around regions found at 1/4 scale
+    BackgroundUpdate background_update = BackgroundUpdate::Average;
+    double background_rate = 0.05;  // Weight of the new frame in each average update
+    int background_interval = 1;     // Update the background every N segmented frames
+    int background_difference = 25;  // Gray difference from the background that counts as foreground
+    int class_prototypes = 0;        // Classify against this many prototypes per class; 0 = every known object
+};
+
+// Tracks regions across frames to maintain consistent color assignment.
+class RegionTracker {
+private:
+    std::vector<float> previousX;
+    std::vector<float> previousY;
+    std::vector<cv::Vec3b> previousColors;
+    std::mt19937 rng;
+    const double MAX_CENTROID_DISTANCE = 50.0;
+
+    // Generates a random color for visualizing regions.
+    cv::Vec3b generateRandomColor();
+
+    // Calculates the Euclidean distance between two points.
+    double calculateDistance(const cv::Point2d& p1, const cv::Point2d& p2);
+
+
+public:
+    RegionTracker() : rng(12345) {}
+
+    // Assigns a color to region i, matching with previous frames if possible.
+    cv::Vec3b getRegionColor(const RegionBatch& regions, size_t i);
+
+    // Replaces the tracked regions with the listed regions of the batch and their colors.
+    void updateRegions(const RegionBatch& regions, const std::pmr::vector<int>& tracked);
+};
+
+// Frame-difference gate for fixed-camera sequences. Each frame is reduced to a gray
+// thumbnail that samples every 4th pixel of every 4th row, and compared tile by tile with
+// the thumbnail of the last processed frame. When no tile's mean absolute difference is
+// above the threshold, the caller can reuse its previous results instead of rerunning the
+// pipeline.
+class FrameChangeGate {
+private:
+    double threshold;
+    int tileSize;
+    int tileCountX = 0;
+    int tileCountY = 0;
+    cv::Size frameSize;
+    std::vector<uchar> referenceThumbnail;  // Thumbnail of the last processed frame
+    std::vector<uchar> currentThumbnail;
+    std::vector<uchar> changedTileFlags;
+    int framesSeen = 0;
+    int framesSkipped = 0;
+
+    // Samples the frame into a gray thumbnail.
+    void buildThumbnail(const cv::Mat& frame, std::vector<uchar>& thumbnail) const;
+
+public:
+    // A threshold of 0 or less disables the gate, so every frame is processed.
+    FrameChangeGate(double threshold, int tileSize) : threshold(threshold), tileSize(tileSize) {}
+
+    // Returns true when the frame has to be processed. The first frame, a change of frame
+    // size and any changed tile all count; the frame then becomes the new reference.
+    bool shouldProcess(const cv::Mat& frame);
+
+    // Per-tile change flags from the last shouldProcess call, row-major, tilesX() * tilesY().
+    const std::vector<uchar>& changedTiles() const { return changedTileFlags; }
+    int tilesX() const { return tileCountX; }
+    int tilesY() const { return tileCountY; }
+    int getTileSize() const { return tileSize; }
+
+    bool enabled() const { return threshold > 0; }
+    int getFramesSeen() const { return framesSeen; }
+    int getFramesSkipped() const { return framesSkipped; }
+
+    // One line of skip statistics, e.g. "Frame gate: skipped 40 of 50 frames (80.0%)".
+    std::string summary() const;
+};
+
+// Monotonic arena for per-frame temporaries, handed to the pipeline as a std::pmr memory
+// resource. Allocations are carved out of one buffer and released all at once by reset() at
+// the end of the frame. A frame that outgrows the buffer spills to the heap, and the next
+// reset grows the buffer to fit it, so steady-state frames make no global allocations.
+class FrameArena {
+private:
+    // Upstream of the arena; counts the bytes a frame had to take from the heap.
+    class SpillResource : public std::pmr::memory_resource {
+    public:
+        size_t spilled = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    std::unique_ptr<std::byte[]> buffer;
+    size_t capacity;
+    SpillResource spill;
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+    int frames = 0;
+    int framesSpilled = 0;
+
+public:
+    explicit FrameArena(size_t initialBytes = 1 << 20);
+
+    std::pmr::memory_resource* getResource() { return &*arena; }
+
+    // Releases everything allocated since the last reset. Containers using the arena must be
+    // gone by then.
+    void reset();
+
+    size_t getCapacity() const { return capacity; }
+
+    // One line of arena statistics, e.g. "Frame arena: 1024 KiB, 2 of 50 frames spilled to the heap".
+    std::string summary() const;
+};
+
+// Automatic threshold for manual_threshold under changing light. The gray histogram of each
+// frame is counted in the gray conversion pass. Otsu's threshold is recomputed from it every
+// interval frames, or sooner when the histogram drifts from the one last used, and the applied
+// threshold moves only part of the way towards it each time, so it follows the light without
+// flickering. In between, a frame costs one histogram comparison.
+class AutoThreshold {
+private:
+    int interval;
+    double drift;
+    double smoothing;
+    std::array<int, 256> referenceHistogram{};  // Histogram of the last recompute
+    long referenceTotal = 0;
+    double smoothedThreshold = 0;
+    int threshold = -1;
+    int framesSinceUpdate = 0;
+    int framesSeen = 0;
+    int updates = 0;
+
+    // True when more than drift of the pixels have moved to another band of 16 gray levels.
+    bool drifted(const std::array<int, 256>& histogram) const;
+
+public:
+    // interval: frames between recomputes. drift: fraction of pixels, between 0 and 1, whose
+    // move triggers an early recompute. smoothing: weight of the new Otsu threshold, in (0, 1].
+    explicit AutoThreshold(int interval = 30, double drift = 0.1, double smoothing = 0.5)
+        : interval(interval), drift(drift), smoothing(smoothing) {}
+
+    // Takes the histogram of the next frame and returns the threshold to apply to it. The
+    // first frame uses its own Otsu threshold.
+    int update(const std::array<int, 256>& histogram);
+
+    int getThreshold() const { return threshold; }
+    int getFramesSeen() const { return framesSeen; }
+    int getUpdates() const { return updates; }
+
+    // One line of statistics, e.g. "Auto threshold: 118, recomputed on 4 of 50 frames".
+    std::string summary() const;
+};
+
+// Per-pixel running background for fixed cameras, an alternative to the adaptive threshold.
+// Foreground is every pixel whose gray value differs from the background by more than
+// background_difference; the background is kept in 8.8 fixed point and follows the scene
+// every background_interval frames. Gray conversion, difference and update run in one pass
+// over parallel row bands, with no blur and no threshold window.
+class BackgroundModel {
+private:
+    PipelineOptions options;
+    cv::Mat background;  // CV_16U, gray level * 256
+    int framesSinceUpdate = 0;
+
+public:
+    explicit BackgroundModel(const PipelineOptions& options) : options(options) {}
+
+    // Returns the cleaned foreground mask of the frame, like segment_frame; thresholded, if
+    // given, receives the raw difference mask. The first frame, or a frame of a new size,
+    // only initializes the background and yields an empty mask.
+    cv::Mat segment(const cv::Mat& frame, cv::Mat* thresholded = nullptr);
+
+    // Forgets the background; the next frame initializes it again.
+    void reset() { background.release(); }
+
+    const cv::Mat& getBackground() const { return background; }
+};
+
+// Keeps the masks, connected components and per-region results of the previous frame and
+// recomputes only the tiles a FrameChangeGate flagged as changed, plus the halo they can
+// influence. Only components that touch the recomputed area are relabeled and get new
+// features; every other region keeps its previous features and classification label.
+class IncrementalSegmenter {
+private:
+    struct Component {
+        Region region;
+        std::string label;
+        bool alive = false;
+        bool fresh = false;  // Recomputed by the last update
+    };
+
+    PipelineOptions options;
+    int minRegionSize;
+    bool computeOrientedBox;
+    BackgroundModel background;           // Used with ThresholdMethod::Background
+    cv::Mat thresholded;
+    cv::Mat cleaned;
+    cv::Mat componentIds;                 // CV_32S, 0 for background
+    std::vector<Component> components;    // Indexed by component id; entry 0 is unused
+    std::vector<int> freeIds;
+    RegionBatch regions;                  // Alive components of at least minRegionSize, largest first
+    std::vector<int> regionIds;           // Component id of each entry in regions
+    int framesUpdated = 0;
+    double recomputedPixels = 0;
+    double totalPixels = 0;
+    long regionsRecomputed = 0;
+    long regionsReused = 0;
+
+    // Re-runs segment_frame on every changed tile and returns the rectangles whose mask was rewritten.
+    // The background method updates its model over the whole frame, so it always rewrites everything.
+    std::pmr::vector<cv::Rect> resegmentTiles(const cv::Mat& frame, const FrameChangeGate& gate,
+                                              std::pmr::memory_resource* memory);
+
+    // Relabels the components that touch the rewritten rectangles.
+    void relabel(const std::pmr::vector<cv::Rect>& dirty, std::pmr::memory_resource* memory);
+
+    // Labels one window of relabel; dropped flags the old component ids being rebuilt.
+    void relabelWindow(const cv::Rect& window, const std::pmr::vector<cv::Rect>& dirty,
+                       const std::pmr::vector<uchar>& dropped, std::pmr::memory_resource* memory);
+
+public:
+    IncrementalSegmenter(const PipelineOptions& options, int minRegionSize, bool computeOrientedBox = false)
+        : options(options), minRegionSize(minRegionSize), computeOrientedBox(computeOrientedBox),
+          background(options), components(1) {}
+
+    // Brings the masks and regions up to date with a frame the gate has just accepted.
+    // The first frame, or a frame of a new size, is processed in full. Temporaries come from
+    // memory, typically a FrameArena's.
+    void update(const cv::Mat& frame, const FrameChangeGate& gate,
+                std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    const cv::Mat& getThresholded() const { return thresholded; }
+    const cv::Mat& getCleaned() const { return cleaned; }
+
+    // Regions of at least minRegionSize pixels, largest first, as extract_regions returns them.
+    const RegionBatch& getRegions() const { return regions; }
+
+    // True when region i was relabeled and re-featured by the last update.
+    bool isRegionNew(size_t i) const { return components[regionIds[i]].fresh; }
+
+    // Classification label cached with region i; it survives as long as the region is untouched.
+    const std::string& getRegionLabel(size_t i) const { return components[regionIds[i]].label; }
+    void setRegionLabel(size_t i, const std::string& label) { components[regionIds[i]].label = label; }
+
+    // One line of work statistics: share of pixels recomputed and of regions reused.
+    std::string summary() const;
+};
+
+// A region closed off by StreamingLabeler. Row coordinates in region are relative to firstRow,
+// the strip row of the region's top edge, so they stay small on an endless strip.
+struct StreamedRegion {
+    Region region;
+    long long firstRow;
+};
+
+// Connected components of an endless mask strip pushed one row at a time, for line-scan
+// cameras. Components are 8-connected, like cv::connectedComponentsWithStats. Only the runs of
+// the previous row and the components they belong to are kept, each with its area, box and
+// raw moments, so memory depends on the strip width and not on its length. A component is
+// emitted with its features as soon as a row arrives that does not continue it.
+class StreamingLabeler {
+private:
+    struct Run {
+        int x0, x1;  // Inclusive
+        int component;
+    };
+    struct Component {
+        int parent;
+        long long top, bottom;
+        int left, right;
+        RawMoments moments;  // Relative to (left, top)
+        int eulerNumber;     // Runs minus pairs of 8-adjacent runs on consecutive rows
+        long long perimeter;  // Crack length
+    };
+
+    int width;
+    int minRegionSize;
+    long long rowsSeen = 0;
+    std::vector<Run> previousRuns;
+    std::vector<Run> currentRuns;
+    std::vector<Component> components;
+    std::vector<int> liveSlots;  // Components continued by the previous row
+    std::vector<int> nextLiveSlots;
+    std::vector<int> createdSlots;
+    std::vector<int> freeSlots;
+    std::vector<uchar> continued;
+    std::vector<StreamedRegion> closed;
+
+    int newComponent(int x0, int x1);
+    int findRoot(int slot);
+    void merge(int a, int b);
+    void emit(const Component& component);
+
+public:
+    StreamingLabeler(int width, int minRegionSize) : width(width), minRegionSize(minRegionSize) {}
+
+    // Adds the next mask row (width pixels, nonzero is foreground) and returns the regions of at
+    // least minRegionSize pixels that it closed off. The result is valid until the next call.
+    const std::vector<StreamedRegion>& pushRow(const uchar* mask);
+
+    // Ends the strip and returns the regions that were still open.
+    const std::vector<StreamedRegion>& finish();
+
+    long long getRowsSeen() const { return rowsSeen; }
+    size_t getOpenComponents() const { return liveSlots.size(); }
+};
+
+// Reads rectangles of an image file. Binary 8-bit PGM and PPM files (P5, P6) are read span
+// by span straight from disk, so memory follows the rectangle size and not the image size;
+// any other format is decoded whole by cv::imread on open.
+class TiledImageReader {
+private:
+    std::ifstream file;
+    cv::Size size;
+    int channels = 0;
+    std::streamoff dataOffset = 0;
+    cv::Mat decoded;  // Whole image, for formats that cannot be read in parts
+
+    // Parses a PGM/PPM header; returns false if the file is not a binary 8-bit one.
+    bool openNetpbm(const std::string& path);
+
+public:
+    // Prints an error and returns false if the file cannot be read.
+    bool open(const std::string& path);
+
+    cv::Size getSize() const { return size; }
+
+    // True when rectangles come from disk rather than from a decoded copy of the whole image.
+    bool streaming() const { return decoded.empty(); }
+
+    // Returns the pixels of rect as BGR, or gray for PGM files.
+    cv::Mat read(const cv::Rect& rect);
+};
+
+// Parses the optional flags in argv[first..argc) into options.
+// Prints an error and returns false on an unknown flag or invalid value.
+bool parse_pipeline_options(int argc, char** argv, int first, PipelineOptions& options);
+
+// Returns the help text describing the optional pipeline flags.
+std::string pipeline_options_usage();
+
+// Converts the frame to grayscale and applies a manual binary threshold.
+cv::Mat manual_threshold(const cv::Mat& frame, int threshold_value);
+
+// Same, at the threshold chosen by an AutoThreshold from the frame's histogram, which is
+// counted while converting to gray.
+cv::Mat manual_threshold(const cv::Mat& frame, AutoThreshold& automatic);
+
+// Result of sweep_thresholds for one frame.
+struct ThresholdSweep {
+    std::array<int, 256> histogram{};  // Gray level counts
+    std::array<int, 256> regions{};    // regions[t]: regions of at least min_region_size in manual_threshold(frame, t)
+    std::vector<cv::Mat> masks;        // Bit k % 8 of masks[k / 8] is manual_threshold(frame, thresholds[k])
+    int otsu = 0;                      // Otsu's threshold for the histogram
+};
+
+// Returns Otsu's threshold for a gray histogram: the t that maximizes the between-class
+// variance of the gray <= t and gray > t classes, the split manual_threshold makes.
+int otsu_threshold(const std::array<int, 256>& histogram);
+
+// Evaluates every manual threshold on a frame at once. One pass converts to gray, builds the
+// histogram and packs the masks of the listed thresholds, eight per byte. The region counts
+// for all 256 thresholds then come from one union-find pass that adds the pixels brightest
+// first: once the pixels above t are in, it holds the components of manual_threshold(frame, t).
+ThresholdSweep sweep_thresholds(const cv::Mat& frame, const std::vector<int>& thresholds, int min_region_size,
+                                std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+// 5x5 Gaussian blur (sigma 0) of a gray or BGR frame through the fixed-point binomial
+// kernels, in parallel row bands. BGR rows are converted to gray inside the blur pass.
+// Bit-exact with cv::cvtColor + cv::GaussianBlur(Size(5, 5), 0).
+cv::Mat gaussian_blur5(const cv::Mat& frame);
+
+// Converts the frame to grayscale and applies Gaussian blur for noise reduction.
+cv::Mat preprocess_image(const cv::Mat& frame);
+
+// Applies adaptive thresholding to create a binary image.
+cv::Mat adaptive_threshold(const cv::Mat& blurred, int block_size = 11, double offset = 2);
+
+// Blurs the gray image and applies a mean adaptive threshold in one tile-parallel pass.
+// Window sums are kept with a sliding row/column sum, so the cost per pixel is O(1)
+// in block_size. Output matches preprocess_image + cv::ADAPTIVE_THRESH_MEAN_C exactly.
+cv::Mat mean_adaptive_threshold(const cv::Mat& gray, int block_size, double offset);
+
+// Produces the binary foreground mask of a BGR frame using the configured method.
+// The background method keeps state across frames and goes through BackgroundModel instead.
+cv::Mat threshold_image(const cv::Mat& frame, const PipelineOptions& options);
+
+// Removes small noise from the binary image using morphological operations.
+cv::Mat clean_image(const cv::Mat& thresholded);
+
+// Runs threshold_image followed by clean_image. With the mean method the whole chain
+// (gray, blur, threshold, close, open) is fused and streamed over row bands, so only a few
+// rows per stage are alive at a time instead of full-frame intermediates; the result is
+// identical to the unfused chain. thresholded, if given, receives the raw threshold mask.
+cv::Mat segment_frame(const cv::Mat& frame, const PipelineOptions& options, cv::Mat* thresholded = nullptr);
+
+// Rows or columns of input context a mask pixel depends on: 2 for the blur, the threshold
+// window radius and 1 for each of the four 3x3 morphology steps. Segmenting a part of a frame
+// with this much context on every side gives exactly the pixels of the whole-frame mask.
+int segmentation_halo(const PipelineOptions& options);
+
+// Segments a 1/4-scale copy of the frame (INTER_AREA, block size scaled to match) and returns
+// the full-resolution boxes of the components that may reach min_region_size, plus a margin,
+// merged so that no two of them touch.
+std::vector<cv::Rect> find_coarse_candidates(const cv::Mat& frame, const PipelineOptions& options,
+                                             int min_region_size);
+
+// Coarse-to-fine segment_frame: runs the full-resolution pipeline only inside the coarse
+// candidates (plus the halo the pipeline needs), leaving both masks empty elsewhere. Inside the
+// candidates the mask is identical to segment_frame, so regions that fit in their candidate box
+// get the same features. computed, if given, receives the rectangles whose mask was computed.
+cv::Mat segment_frame_coarse_to_fine(const cv::Mat& frame, const PipelineOptions& options, int min_region_size,
+                                     cv::Mat* thresholded = nullptr, std::vector<cv::Rect>* computed = nullptr);
+
+// Labels the 8-connected components of a binary mask like cv::connectedComponentsWithStats,
+// without the centroids. The label image is CV_16U when the labels fit in 16 bits and CV_32S
+// otherwise, halving its write bandwidth in the common case; callers that only need the stats
+// pass nullptr and no label image is written. Row 0 of stats spans the whole image. Returns the
+// number of labels, background included.
+int label_components(const cv::Mat& mask, cv::Mat* labels, cv::Mat& stats,
+                     std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+// Reads one label of a label_components image, whichever depth it has.
+inline int label_at(const cv::Mat& labels, int y, int x) {
+    return labels.depth() == CV_16U ? labels.at<ushort>(y, x) : labels.at<int>(y, x);
+}
+
+// Region extraction for images too large to process whole. The image is segmented in
+// tile_size x tile_size tiles, each read with segmentation_halo() pixels of context so its mask
+// is exactly that of the whole image. Each tile is labeled on its own, and components that
+// cross tile seams are merged through a union-find that only holds the components still open
+// at the current row of tiles. Returns the regions extract_regions would find in the whole
+// mask, largest first, without the oriented box; the moment axis uses each region's own pixels.
+RegionBatch extract_regions_tiled(TiledImageReader& reader, const PipelineOptions& options,
+                                  int min_region_size, int tile_size);
+
+// Extracts connected regions and computes their properties, largest first. The oriented
+// bounding box is fitted to a convex hull built from the extent of each row of the region,
+// which the labeling scan only records when asked, so both are opt-in.
+RegionBatch extract_regions(const cv::Mat& cleaned, int min_region_size, bool compute_oriented_box = false,
+                            std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+// Draws region details, like bounding box, centroid and axis, on the output image.
+void draw_region_information(cv::Mat& output, const RegionBatch& regions, size_t i, const cv::Vec3b& color);
+
+// Visualizes regions with annotations and consistent colors across frames.
+cv::Mat visualize_regions(const cv::Mat& original, const cv::Mat& labels,
+                          const RegionBatch& regions,
+                          RegionTracker& tracker, int max_regions,
+                          std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+// Log scale used for Hu invariants in feature vectors: -sign(h) log10|h|, and 0 for h = 0.
+double hu_feature(double hu);
+
+// Builds the classifier feature vector for a region.
+FeatureVector make_feature_vector(const Region& region, const std::string& label = "");
+FeatureVector make_feature_vector(const RegionBatch& regions, size_t i, const std::string& label = "");
+
+// Appends the feature vector of region i, along with its label, to a CSV file. A new file starts
+// with a "#dimension,N" header and gets every feature; an existing file keeps its dimension.
+void save_feature_vector(const std::string& filename, const RegionBatch& regions, size_t i, const std::string& label);
+
+// Loads the known objects database from a CSV file. The dimension comes from the "#dimension,N"
+// header. Files written before it have the four original columns, optionally followed by the
+// Euler number, hole count, perimeter, compactness and Hu columns; those load with the Euler
+// column dropped and the dimension of their first row. Longer rows are cut to the dimension
+// and shorter ones are skipped with a warning.
+std::vector<FeatureVector> load_known_objects(const std::string& filename);
+
+// Distances use the features both vectors have, normally the database's dimension. Kernels are
+// instantiated for 4, 8 and 16 features so their loops unroll, with a generic loop otherwise.
+
+// Computes the scaled Euclidean distance between two feature vectors.
+double compute_scaled_euclidean_distance(const FeatureVector& fv1, const FeatureVector& fv2,
+                                         const std::vector<double>& stdevs);
+
+// Computes the unscaled Euclidean distance between two feature vectors.
+double compute_euclidean_distance(const FeatureVector& fv1, const FeatureVector& fv2);
+
+// Computes the Manhattan distance between two feature vectors.
+double compute_manhattan_distance(const FeatureVector& fv1, const FeatureVector& fv2);
+
+// Computes the distance between two feature vectors under any of the metrics. All of them
+// satisfy the triangle inequality.
+double compute_feature_distance(const FeatureVector& fv1, const FeatureVector& fv2, const std::vector<double>& stdevs,
+                                DistanceMetric metric);
+
+// Computes the standard deviations of the features in the known objects database, one per
+// dimension. A feature that does not vary, like a hole count that is always 0, gets 1.
+std::vector<double> compute_feature_stdevs(const std::vector<FeatureVector>& known_objects);
+
+// Condenses the known objects into per_class prototypes per label, so classification costs
+// O(labels * per_class) distances instead of one per known object. One prototype is the class
+// mean; more are k-means centers under the scaled Euclidean metric. A class with no more
+// objects than per_class keeps them. Classify with the stdevs of the full database.
+std::vector<FeatureVector> class_prototypes(const std::vector<FeatureVector>& known_objects,
+                                            const std::vector<double>& stdevs, int per_class);
+
+// Classifies a feature vector by finding the closest match in the known objects.
+std::string classify_feature_vector(const FeatureVector& fv, const std::vector<FeatureVector>& known_objects,
+                                    const std::vector<double>& stdevs, DistanceMetric metric);
+
+class PackedFeatureDatabase;
+
+// Classifies the listed regions of a batch at once, returning one label per index. The
+// distances to each known object are computed for all regions in one pass over the feature
+// columns; the result is the same as classify_feature_vector on each region.
+std::vector<std::string> classify_regions(const RegionBatch& regions, const std::vector<int>& indices,
+                                          const std::vector<FeatureVector>& known_objects,
+                                          const std::vector<double>& stdevs, DistanceMetric metric);
+
+// Same, against a database packed beforehand, returning the nearest known object of each
+// listed region (-1 if the database is empty); database.getLabel names it. The result and all
+// scratch space come from memory, so per-frame classification stays off the heap.
+std::pmr::vector<int> classify_regions(const RegionBatch& regions, const std::pmr::vector<int>& indices,
+                                       const PackedFeatureDatabase& database,
+                                       std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+// A known objects database packed once, when it is loaded, for classify_regions: each object
+// is a row of one fixed width, padded with zeros to the next fixed-size distance kernel, and
+// the metric's per-feature scale is padded the same way. A database whose objects differ in
+// dimension cannot be packed and is searched like classify_feature_vector instead.
+class PackedFeatureDatabase {
+private:
+    DistanceMetric metric;
+    int dimension = 0;
+    int width = 0;
+    std::vector<double> rows;             // width values per object
+    std::vector<double> scale;            // Padded stdevs for the scaled Euclidean metric
+    std::vector<std::string> labels;
+    std::vector<FeatureVector> unpacked;  // Only for a database of mixed dimension
+    std::vector<double> stdevs;
+
+    friend std::pmr::vector<int> classify_regions(const RegionBatch& regions, const std::pmr::vector<int>& indices,
+                                                  const PackedFeatureDatabase& database,
+                                                  std::pmr::memory_resource* memory);
+
+public:
+    PackedFeatureDatabase(const std::vector<FeatureVector>& known_objects, const std::vector<double>& stdevs,
+                          DistanceMetric metric);
+
+    size_t size() const { return labels.size(); }
+    bool empty() const { return labels.empty(); }
+
+    // Label of a known object, or "Unknown" for -1.
+    const std::string& getLabel(int object) const;
+};
+
+#endif // VISION_CORE_H
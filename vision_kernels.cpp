@@ -0,0 +1,892 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: vision_kernels.cpp
+Purpose: Implements the per-row pixel kernels declared in vision_kernels.h. Every kernel
+has a scalar reference version and SSE4.2 / AVX2 / AVX-512 versions that are compiled
+with per-function target attributes, so a single translation unit built without any
+-m flags still carries all variants. The variant is chosen once at startup via cpuid.
+*/
+
+#include "vision_kernels.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define VISION_X86 1
+#include <immintrin.h>
+#define VISION_TARGET(isa) __attribute__((target(isa)))
+#else
+#define VISION_X86 0
+#endif
+
+namespace {
+
+// BT.601 luma weights in Q14, the same fixed-point constants OpenCV uses for 8-bit BGR2GRAY.
+constexpr int kGrayShift = 14;
+constexpr int kGrayRound = 1 << (kGrayShift - 1);
+constexpr int kB2Y = 1868;
+constexpr int kG2Y = 9617;
+constexpr int kR2Y = 4899;
+
+// The 5x5 Gaussian with sigma 0 is the outer product of the binomial taps 1-4-6-4-1, so the
+// full 2-D weight sum is 256 and the whole filter stays integer; every lane fits in 16 bits.
+constexpr int kGaussShift = 8;
+constexpr int kGaussRound = 1 << (kGaussShift - 1);
+
+// ---------------------------------------------------------------------------
+// Scalar reference kernels
+// ---------------------------------------------------------------------------
+
+void bgr_to_gray_row_scalar(const std::uint8_t* bgr, std::uint8_t* gray, int width) {
+    for (int x = 0; x < width; ++x) {
+        const std::uint8_t* p = bgr + 3 * x;
+        gray[x] = static_cast<std::uint8_t>(
+            (p[0] * kB2Y + p[1] * kG2Y + p[2] * kR2Y + kGrayRound) >> kGrayShift);
+    }
+}
+
+void threshold_row_scalar(const std::uint8_t* src, std::uint8_t* dst, int width,
+                          std::uint8_t thresh, std::uint8_t maxval) {
+    for (int x = 0; x < width; ++x) {
+        dst[x] = src[x] > thresh ? maxval : 0;
+    }
+}
+
+void column_sum_update_scalar(std::int32_t* sums, const std::uint8_t* add, const std::uint8_t* sub, int width) {
+    for (int x = 0; x < width; ++x) {
+        sums[x] += add[x] - sub[x];
+    }
+}
+
+// 3x3 min/max at column x, clamping the horizontal window to the row.
+inline std::uint8_t morph3_at(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* c,
+                              int x, int width, bool dilate) {
+    int lo = x > 0 ? x - 1 : x;
+    int hi = x + 1 < width ? x + 1 : x;
+    std::uint8_t v = b[x];
+    for (int i = lo; i <= hi; ++i) {
+        std::uint8_t m = dilate ? std::max({a[i], b[i], c[i]}) : std::min({a[i], b[i], c[i]});
+        v = dilate ? std::max(v, m) : std::min(v, m);
+    }
+    return v;
+}
+
+void morph3_row_scalar(const std::uint8_t* above, const std::uint8_t* row, const std::uint8_t* below,
+                       std::uint8_t* dst, int width, bool dilate) {
+    // A missing neighbour row is replaced by the row itself, which leaves min/max unchanged
+    const std::uint8_t* a = above ? above : row;
+    const std::uint8_t* c = below ? below : row;
+    for (int x = 0; x < width; ++x) {
+        dst[x] = morph3_at(a, row, c, x, width, dilate);
+    }
+}
+
+// Mirrors a column index into the row without repeating the edge (cv::BORDER_REFLECT_101).
+inline int reflect101(int i, int width) {
+    if (width == 1) return 0;
+    while (i < 0 || i >= width) {
+        i = i < 0 ? -i : 2 * (width - 1) - i;
+    }
+    return i;
+}
+
+// Horizontal 1-4-6-4-1 sum at column x, reflecting the taps that fall outside the row.
+inline std::uint16_t gaussian5_at(const std::uint8_t* src, int x, int width) {
+    if (x >= 2 && x + 2 < width) {
+        return static_cast<std::uint16_t>(src[x - 2] + src[x + 2] + 4 * (src[x - 1] + src[x + 1]) + 6 * src[x]);
+    }
+    return static_cast<std::uint16_t>(
+        src[reflect101(x - 2, width)] + src[reflect101(x + 2, width)] +
+        4 * (src[reflect101(x - 1, width)] + src[reflect101(x + 1, width)]) + 6 * src[x]);
+}
+
+void gaussian5_row_h_scalar(const std::uint8_t* src, std::uint16_t* dst, int width) {
+    for (int x = 0; x < width; ++x) {
+        dst[x] = gaussian5_at(src, x, width);
+    }
+}
+
+// Vertical pass for columns [from, width).
+void gaussian5_row_v_from(const std::uint16_t* const* rows, std::uint8_t* dst, int from, int width) {
+    const std::uint16_t* r0 = rows[0];
+    const std::uint16_t* r1 = rows[1];
+    const std::uint16_t* r2 = rows[2];
+    const std::uint16_t* r3 = rows[3];
+    const std::uint16_t* r4 = rows[4];
+    for (int x = from; x < width; ++x) {
+        int sum = r0[x] + r4[x] + 4 * (r1[x] + r3[x]) + 6 * r2[x];
+        dst[x] = static_cast<std::uint8_t>((sum + kGaussRound) >> kGaussShift);
+    }
+}
+
+void gaussian5_row_v_scalar(const std::uint16_t* const* rows, std::uint8_t* dst, int width) {
+    gaussian5_row_v_from(rows, dst, 0, width);
+}
+
+// The SIMD versions below compute the same thing with saturating unsigned 16-bit lanes:
+// the step towards the target is split into its positive and negative parts.
+void background_average_row_scalar(std::uint16_t* bg, const std::uint8_t* gray, int width, int rate) {
+    for (int x = 0; x < width; ++x) {
+        int target = gray[x] << 8;
+        int up = std::max(target - bg[x], 0);
+        int down = std::max(bg[x] - target, 0);
+        bg[x] = static_cast<std::uint16_t>(bg[x] + ((up * rate) >> 8) - ((down * rate) >> 8));
+    }
+}
+
+void background_median_row_scalar(std::uint16_t* bg, const std::uint8_t* gray, int width) {
+    for (int x = 0; x < width; ++x) {
+        int target = gray[x] << 8;
+        int up = std::min(std::max(target - bg[x], 0), 256);
+        int down = std::min(std::max(bg[x] - target, 0), 256);
+        bg[x] = static_cast<std::uint16_t>(bg[x] + up - down);
+    }
+}
+
+void background_diff_row_scalar(const std::uint16_t* bg, const std::uint8_t* gray, std::uint8_t* dst,
+                                int width, std::uint8_t thresh) {
+    for (int x = 0; x < width; ++x) {
+        int level = (bg[x] + 128) >> 8;
+        dst[x] = std::abs(gray[x] - level) > thresh ? 255 : 0;
+    }
+}
+
+#if VISION_X86
+
+// ---------------------------------------------------------------------------
+// SSE4.2 kernels
+// ---------------------------------------------------------------------------
+
+// Splits 16 interleaved BGR pixels (48 bytes) into planar B, G and R vectors.
+VISION_TARGET("sse4.2")
+inline void deinterleave_bgr16(const std::uint8_t* p, __m128i& b, __m128i& g, __m128i& r) {
+    const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+    const __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+
+    b = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+    g = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+    r = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+}
+
+// Weighted sum of 8 B/G/R pixels held in 16-bit lanes; returns eight 16-bit gray values.
+VISION_TARGET("sse4.2")
+inline __m128i gray_from_epi16_sse(__m128i b, __m128i g, __m128i r) {
+    const __m128i coeff_bg = _mm_set1_epi32((kG2Y << 16) | kB2Y);
+    const __m128i coeff_r1 = _mm_set1_epi32((kGrayRound << 16) | kR2Y);
+    const __m128i one = _mm_set1_epi16(1);
+
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(b, g), coeff_bg),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(r, one), coeff_r1));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(b, g), coeff_bg),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(r, one), coeff_r1));
+    return _mm_packs_epi32(_mm_srli_epi32(lo, kGrayShift), _mm_srli_epi32(hi, kGrayShift));
+}
+
+VISION_TARGET("sse4.2")
+void bgr_to_gray_row_sse42(const std::uint8_t* bgr, std::uint8_t* gray, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i b, g, r;
+        deinterleave_bgr16(bgr + 3 * x, b, g, r);
+        __m128i lo = gray_from_epi16_sse(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(g, zero),
+                                         _mm_unpacklo_epi8(r, zero));
+        __m128i hi = gray_from_epi16_sse(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(g, zero),
+                                         _mm_unpackhi_epi8(r, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gray + x), _mm_packus_epi16(lo, hi));
+    }
+    bgr_to_gray_row_scalar(bgr + 3 * x, gray + x, width - x);
+}
+
+VISION_TARGET("sse4.2")
+void threshold_row_sse42(const std::uint8_t* src, std::uint8_t* dst, int width,
+                         std::uint8_t thresh, std::uint8_t maxval) {
+    const __m128i t = _mm_set1_epi8(static_cast<char>(thresh));
+    const __m128i m = _mm_set1_epi8(static_cast<char>(maxval));
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        // src - thresh saturates to zero exactly when src <= thresh
+        __m128i not_above = _mm_cmpeq_epi8(_mm_subs_epu8(v, t), zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_andnot_si128(not_above, m));
+    }
+    threshold_row_scalar(src + x, dst + x, width - x, thresh, maxval);
+}
+
+VISION_TARGET("sse4.2")
+void column_sum_update_sse42(std::int32_t* sums, const std::uint8_t* add, const std::uint8_t* sub, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        // add - sub fits in 16 bits, so widen once and only sign-extend the difference
+        __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(add + x)));
+        __m128i s = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sub + x)));
+        __m128i d = _mm_sub_epi16(a, s);
+        __m128i* out = reinterpret_cast<__m128i*>(sums + x);
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), _mm_cvtepi16_epi32(d)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_cvtepi16_epi32(_mm_srli_si128(d, 8))));
+    }
+    column_sum_update_scalar(sums + x, add + x, sub + x, width - x);
+}
+
+// Vertical 3-row min/max of the 16-byte block starting at column x.
+VISION_TARGET("sse4.2")
+inline __m128i morph3_column_sse42(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* c,
+                                int x, bool dilate) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+    __m128i vc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + x));
+    return dilate ? _mm_max_epu8(_mm_max_epu8(va, vb), vc) : _mm_min_epu8(_mm_min_epu8(va, vb), vc);
+}
+
+VISION_TARGET("sse4.2")
+void morph3_row_sse42(const std::uint8_t* above, const std::uint8_t* row, const std::uint8_t* below,
+                      std::uint8_t* dst, int width, bool dilate) {
+    const std::uint8_t* a = above ? above : row;
+    const std::uint8_t* c = below ? below : row;
+    if (width < 18) {
+        morph3_row_scalar(a, row, c, dst, width, dilate);
+        return;
+    }
+    dst[0] = morph3_at(a, row, c, 0, width, dilate);
+    int x = 1;
+    for (; x + 17 <= width; x += 16) {
+        __m128i l = morph3_column_sse42(a, row, c, x - 1, dilate);
+        __m128i m = morph3_column_sse42(a, row, c, x, dilate);
+        __m128i r = morph3_column_sse42(a, row, c, x + 1, dilate);
+        __m128i v = dilate ? _mm_max_epu8(_mm_max_epu8(l, m), r) : _mm_min_epu8(_mm_min_epu8(l, m), r);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), v);
+    }
+    for (; x < width; ++x) {
+        dst[x] = morph3_at(a, row, c, x, width, dilate);
+    }
+}
+
+// a + e + 4 (b + d) + 6 c in unsigned 16-bit lanes, with the multiplies done as shifts.
+// Even the vertical pass peaks at 255 * 256, so the lanes never wrap.
+VISION_TARGET("sse4.2")
+inline __m128i binomial5_epi16_sse(__m128i a, __m128i b, __m128i c, __m128i d, __m128i e) {
+    __m128i outer = _mm_add_epi16(a, e);
+    __m128i inner = _mm_slli_epi16(_mm_add_epi16(b, d), 2);
+    __m128i center = _mm_add_epi16(_mm_slli_epi16(c, 2), _mm_slli_epi16(c, 1));
+    return _mm_add_epi16(_mm_add_epi16(outer, inner), center);
+}
+
+VISION_TARGET("sse4.2")
+inline __m128i load_epu8_epi16_sse(const std::uint8_t* p) {
+    return _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+
+VISION_TARGET("sse4.2")
+void gaussian5_row_h_sse42(const std::uint8_t* src, std::uint16_t* dst, int width) {
+    int x = 0;
+    for (; x < 2 && x < width; ++x) {
+        dst[x] = gaussian5_at(src, x, width);
+    }
+    // Interior columns: every tap is inside the row, 8 outputs per step
+    for (; x + 10 <= width; x += 8) {
+        __m128i v = binomial5_epi16_sse(load_epu8_epi16_sse(src + x - 2), load_epu8_epi16_sse(src + x - 1),
+                                        load_epu8_epi16_sse(src + x), load_epu8_epi16_sse(src + x + 1),
+                                        load_epu8_epi16_sse(src + x + 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), v);
+    }
+    for (; x < width; ++x) {
+        dst[x] = gaussian5_at(src, x, width);
+    }
+}
+
+// Vertical pass of 8 columns starting at x; returns the rounded results in 16-bit lanes.
+VISION_TARGET("sse4.2")
+inline __m128i gaussian5_column_sse42(const std::uint16_t* const* rows, int x) {
+    __m128i r[5];
+    for (int k = 0; k < 5; ++k) {
+        r[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + x));
+    }
+    __m128i sum = binomial5_epi16_sse(r[0], r[1], r[2], r[3], r[4]);
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(kGaussRound)), kGaussShift);
+}
+
+// Vertical pass for columns [x, width).
+VISION_TARGET("sse4.2")
+void gaussian5_row_v_sse42_from(const std::uint16_t* const* rows, std::uint8_t* dst, int x, int width) {
+    for (; x + 16 <= width; x += 16) {
+        __m128i lo = gaussian5_column_sse42(rows, x);
+        __m128i hi = gaussian5_column_sse42(rows, x + 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+    }
+    gaussian5_row_v_from(rows, dst, x, width);
+}
+
+VISION_TARGET("sse4.2")
+void gaussian5_row_v_sse42(const std::uint16_t* const* rows, std::uint8_t* dst, int width) {
+    gaussian5_row_v_sse42_from(rows, dst, 0, width);
+}
+
+VISION_TARGET("sse4.2")
+void background_average_row_sse42(std::uint16_t* bg, const std::uint8_t* gray, int width, int rate) {
+    const __m128i r = _mm_set1_epi16(static_cast<short>(rate << 8));
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i target = _mm_slli_epi16(
+            _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(gray + x))), 8);
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + x));
+        // mulhi by rate * 256 is (diff * rate) >> 8
+        __m128i up = _mm_mulhi_epu16(_mm_subs_epu16(target, b), r);
+        __m128i down = _mm_mulhi_epu16(_mm_subs_epu16(b, target), r);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bg + x), _mm_sub_epi16(_mm_add_epi16(b, up), down));
+    }
+    background_average_row_scalar(bg + x, gray + x, width - x, rate);
+}
+
+VISION_TARGET("sse4.2")
+void background_median_row_sse42(std::uint16_t* bg, const std::uint8_t* gray, int width) {
+    const __m128i step = _mm_set1_epi16(256);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i target = _mm_slli_epi16(
+            _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(gray + x))), 8);
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + x));
+        __m128i up = _mm_min_epu16(_mm_subs_epu16(target, b), step);
+        __m128i down = _mm_min_epu16(_mm_subs_epu16(b, target), step);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bg + x), _mm_sub_epi16(_mm_add_epi16(b, up), down));
+    }
+    background_median_row_scalar(bg + x, gray + x, width - x);
+}
+
+VISION_TARGET("sse4.2")
+void background_diff_row_sse42(const std::uint16_t* bg, const std::uint8_t* gray, std::uint8_t* dst,
+                               int width, std::uint8_t thresh) {
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i t = _mm_set1_epi8(static_cast<char>(thresh));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8(-1);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + x));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + x + 8));
+        __m128i level = _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, round), 8),
+                                         _mm_srli_epi16(_mm_add_epi16(hi, round), 8));
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + x));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(g, level), _mm_subs_epu8(level, g));
+        __m128i not_above = _mm_cmpeq_epi8(_mm_subs_epu8(diff, t), zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_andnot_si128(not_above, ones));
+    }
+    background_diff_row_scalar(bg + x, gray + x, dst + x, width - x, thresh);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels
+// ---------------------------------------------------------------------------
+
+VISION_TARGET("avx2")
+inline __m256i gray_from_epi16_avx2(__m256i b, __m256i g, __m256i r) {
+    const __m256i coeff_bg = _mm256_set1_epi32((kG2Y << 16) | kB2Y);
+    const __m256i coeff_r1 = _mm256_set1_epi32((kGrayRound << 16) | kR2Y);
+    const __m256i one = _mm256_set1_epi16(1);
+
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(b, g), coeff_bg),
+                                  _mm256_madd_epi16(_mm256_unpacklo_epi16(r, one), coeff_r1));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(b, g), coeff_bg),
+                                  _mm256_madd_epi16(_mm256_unpackhi_epi16(r, one), coeff_r1));
+    return _mm256_packs_epi32(_mm256_srli_epi32(lo, kGrayShift), _mm256_srli_epi32(hi, kGrayShift));
+}
+
+VISION_TARGET("avx2")
+void bgr_to_gray_row_avx2(const std::uint8_t* bgr, std::uint8_t* gray, int width) {
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m128i b0, g0, r0, b1, g1, r1;
+        deinterleave_bgr16(bgr + 3 * x, b0, g0, r0);
+        deinterleave_bgr16(bgr + 3 * x + 48, b1, g1, r1);
+        // Unpack and pack both work per 128-bit lane, so lane order is preserved end to end
+        __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(b0), b1, 1);
+        __m256i g = _mm256_inserti128_si256(_mm256_castsi128_si256(g0), g1, 1);
+        __m256i r = _mm256_inserti128_si256(_mm256_castsi128_si256(r0), r1, 1);
+        __m256i lo = gray_from_epi16_avx2(_mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi8(g, zero),
+                                          _mm256_unpacklo_epi8(r, zero));
+        __m256i hi = gray_from_epi16_avx2(_mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi8(g, zero),
+                                          _mm256_unpackhi_epi8(r, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gray + x), _mm256_packus_epi16(lo, hi));
+    }
+    bgr_to_gray_row_sse42(bgr + 3 * x, gray + x, width - x);
+}
+
+VISION_TARGET("avx2")
+void threshold_row_avx2(const std::uint8_t* src, std::uint8_t* dst, int width,
+                        std::uint8_t thresh, std::uint8_t maxval) {
+    const __m256i t = _mm256_set1_epi8(static_cast<char>(thresh));
+    const __m256i m = _mm256_set1_epi8(static_cast<char>(maxval));
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i not_above = _mm256_cmpeq_epi8(_mm256_subs_epu8(v, t), zero);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_andnot_si256(not_above, m));
+    }
+    threshold_row_sse42(src + x, dst + x, width - x, thresh, maxval);
+}
+
+VISION_TARGET("avx2")
+void column_sum_update_avx2(std::int32_t* sums, const std::uint8_t* add, const std::uint8_t* sub, int width) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(add + x)));
+        __m256i s = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + x)));
+        __m256i d = _mm256_sub_epi16(a, s);
+        __m256i* out = reinterpret_cast<__m256i*>(sums + x);
+        _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out),
+                                                  _mm256_cvtepi16_epi32(_mm256_castsi256_si128(d))));
+        _mm256_storeu_si256(out + 1, _mm256_add_epi32(_mm256_loadu_si256(out + 1),
+                                                      _mm256_cvtepi16_epi32(_mm256_extracti128_si256(d, 1))));
+    }
+    column_sum_update_sse42(sums + x, add + x, sub + x, width - x);
+}
+
+// Vertical 3-row min/max of the 32-byte block starting at column x.
+VISION_TARGET("avx2")
+inline __m256i morph3_column_avx2(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* c,
+                                int x, bool dilate) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x));
+    __m256i vc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c + x));
+    return dilate ? _mm256_max_epu8(_mm256_max_epu8(va, vb), vc) : _mm256_min_epu8(_mm256_min_epu8(va, vb), vc);
+}
+
+VISION_TARGET("avx2")
+void morph3_row_avx2(const std::uint8_t* above, const std::uint8_t* row, const std::uint8_t* below,
+                     std::uint8_t* dst, int width, bool dilate) {
+    const std::uint8_t* a = above ? above : row;
+    const std::uint8_t* c = below ? below : row;
+    if (width < 34) {
+        morph3_row_sse42(a, row, c, dst, width, dilate);
+        return;
+    }
+    dst[0] = morph3_at(a, row, c, 0, width, dilate);
+    int x = 1;
+    for (; x + 33 <= width; x += 32) {
+        __m256i l = morph3_column_avx2(a, row, c, x - 1, dilate);
+        __m256i m = morph3_column_avx2(a, row, c, x, dilate);
+        __m256i r = morph3_column_avx2(a, row, c, x + 1, dilate);
+        __m256i v = dilate ? _mm256_max_epu8(_mm256_max_epu8(l, m), r) : _mm256_min_epu8(_mm256_min_epu8(l, m), r);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), v);
+    }
+    for (; x < width; ++x) {
+        dst[x] = morph3_at(a, row, c, x, width, dilate);
+    }
+}
+
+VISION_TARGET("avx2")
+inline __m256i binomial5_epi16_avx2(__m256i a, __m256i b, __m256i c, __m256i d, __m256i e) {
+    __m256i outer = _mm256_add_epi16(a, e);
+    __m256i inner = _mm256_slli_epi16(_mm256_add_epi16(b, d), 2);
+    __m256i center = _mm256_add_epi16(_mm256_slli_epi16(c, 2), _mm256_slli_epi16(c, 1));
+    return _mm256_add_epi16(_mm256_add_epi16(outer, inner), center);
+}
+
+VISION_TARGET("avx2")
+inline __m256i load_epu8_epi16_avx2(const std::uint8_t* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+VISION_TARGET("avx2")
+void gaussian5_row_h_avx2(const std::uint8_t* src, std::uint16_t* dst, int width) {
+    if (width < 20) {
+        gaussian5_row_h_sse42(src, dst, width);
+        return;
+    }
+    dst[0] = gaussian5_at(src, 0, width);
+    dst[1] = gaussian5_at(src, 1, width);
+    int x = 2;
+    for (; x + 18 <= width; x += 16) {
+        __m256i v = binomial5_epi16_avx2(load_epu8_epi16_avx2(src + x - 2), load_epu8_epi16_avx2(src + x - 1),
+                                         load_epu8_epi16_avx2(src + x), load_epu8_epi16_avx2(src + x + 1),
+                                         load_epu8_epi16_avx2(src + x + 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), v);
+    }
+    for (; x < width; ++x) {
+        dst[x] = gaussian5_at(src, x, width);
+    }
+}
+
+VISION_TARGET("avx2")
+inline __m256i gaussian5_column_avx2(const std::uint16_t* const* rows, int x) {
+    __m256i r[5];
+    for (int k = 0; k < 5; ++k) {
+        r[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + x));
+    }
+    __m256i sum = binomial5_epi16_avx2(r[0], r[1], r[2], r[3], r[4]);
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(kGaussRound)), kGaussShift);
+}
+
+VISION_TARGET("avx2")
+void gaussian5_row_v_avx2_from(const std::uint16_t* const* rows, std::uint8_t* dst, int x, int width) {
+    for (; x + 32 <= width; x += 32) {
+        __m256i lo = gaussian5_column_avx2(rows, x);
+        __m256i hi = gaussian5_column_avx2(rows, x + 16);
+        // packus works per 128-bit lane; restore column order across the lanes
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), packed);
+    }
+    gaussian5_row_v_sse42_from(rows, dst, x, width);
+}
+
+VISION_TARGET("avx2")
+void gaussian5_row_v_avx2(const std::uint16_t* const* rows, std::uint8_t* dst, int width) {
+    gaussian5_row_v_avx2_from(rows, dst, 0, width);
+}
+
+VISION_TARGET("avx2")
+void background_average_row_avx2(std::uint16_t* bg, const std::uint8_t* gray, int width, int rate) {
+    const __m256i r = _mm256_set1_epi16(static_cast<short>(rate << 8));
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i target = _mm256_slli_epi16(
+            _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + x))), 8);
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + x));
+        __m256i up = _mm256_mulhi_epu16(_mm256_subs_epu16(target, b), r);
+        __m256i down = _mm256_mulhi_epu16(_mm256_subs_epu16(b, target), r);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(bg + x), _mm256_sub_epi16(_mm256_add_epi16(b, up), down));
+    }
+    background_average_row_sse42(bg + x, gray + x, width - x, rate);
+}
+
+VISION_TARGET("avx2")
+void background_median_row_avx2(std::uint16_t* bg, const std::uint8_t* gray, int width) {
+    const __m256i step = _mm256_set1_epi16(256);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i target = _mm256_slli_epi16(
+            _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + x))), 8);
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + x));
+        __m256i up = _mm256_min_epu16(_mm256_subs_epu16(target, b), step);
+        __m256i down = _mm256_min_epu16(_mm256_subs_epu16(b, target), step);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(bg + x), _mm256_sub_epi16(_mm256_add_epi16(b, up), down));
+    }
+    background_median_row_sse42(bg + x, gray + x, width - x);
+}
+
+VISION_TARGET("avx2")
+void background_diff_row_avx2(const std::uint16_t* bg, const std::uint8_t* gray, std::uint8_t* dst,
+                              int width, std::uint8_t thresh) {
+    const __m256i round = _mm256_set1_epi16(128);
+    const __m256i t = _mm256_set1_epi8(static_cast<char>(thresh));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8(-1);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + x));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + x + 16));
+        // packus interleaves the 128-bit lanes; the permute puts the pixels back in order
+        __m256i level = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(_mm256_srli_epi16(_mm256_add_epi16(lo, round), 8),
+                                _mm256_srli_epi16(_mm256_add_epi16(hi, round), 8)), 0xD8);
+        __m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gray + x));
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(g, level), _mm256_subs_epu8(level, g));
+        __m256i not_above = _mm256_cmpeq_epi8(_mm256_subs_epu8(diff, t), zero);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_andnot_si256(not_above, ones));
+    }
+    background_diff_row_sse42(bg + x, gray + x, dst + x, width - x, thresh);
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512 (F + BW) kernels
+// ---------------------------------------------------------------------------
+
+VISION_TARGET("avx512f,avx512bw")
+inline __m512i gray_from_epi16_avx512(__m512i b, __m512i g, __m512i r) {
+    const __m512i coeff_bg = _mm512_set1_epi32((kG2Y << 16) | kB2Y);
+    const __m512i coeff_r1 = _mm512_set1_epi32((kGrayRound << 16) | kR2Y);
+    const __m512i one = _mm512_set1_epi16(1);
+
+    __m512i lo = _mm512_add_epi32(_mm512_madd_epi16(_mm512_unpacklo_epi16(b, g), coeff_bg),
+                                  _mm512_madd_epi16(_mm512_unpacklo_epi16(r, one), coeff_r1));
+    __m512i hi = _mm512_add_epi32(_mm512_madd_epi16(_mm512_unpackhi_epi16(b, g), coeff_bg),
+                                  _mm512_madd_epi16(_mm512_unpackhi_epi16(r, one), coeff_r1));
+    return _mm512_packs_epi32(_mm512_srli_epi32(lo, kGrayShift), _mm512_srli_epi32(hi, kGrayShift));
+}
+
+VISION_TARGET("avx512f,avx512bw")
+inline __m512i combine_lanes_avx512(__m128i l0, __m128i l1, __m128i l2, __m128i l3) {
+    __m512i v = _mm512_castsi128_si512(l0);
+    v = _mm512_inserti32x4(v, l1, 1);
+    v = _mm512_inserti32x4(v, l2, 2);
+    return _mm512_inserti32x4(v, l3, 3);
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void bgr_to_gray_row_avx512(const std::uint8_t* bgr, std::uint8_t* gray, int width) {
+    const __m512i zero = _mm512_setzero_si512();
+    int x = 0;
+    for (; x + 64 <= width; x += 64) {
+        __m128i b[4], g[4], r[4];
+        for (int k = 0; k < 4; ++k) {
+            deinterleave_bgr16(bgr + 3 * (x + 16 * k), b[k], g[k], r[k]);
+        }
+        __m512i bv = combine_lanes_avx512(b[0], b[1], b[2], b[3]);
+        __m512i gv = combine_lanes_avx512(g[0], g[1], g[2], g[3]);
+        __m512i rv = combine_lanes_avx512(r[0], r[1], r[2], r[3]);
+        __m512i lo = gray_from_epi16_avx512(_mm512_unpacklo_epi8(bv, zero), _mm512_unpacklo_epi8(gv, zero),
+                                            _mm512_unpacklo_epi8(rv, zero));
+        __m512i hi = gray_from_epi16_avx512(_mm512_unpackhi_epi8(bv, zero), _mm512_unpackhi_epi8(gv, zero),
+                                            _mm512_unpackhi_epi8(rv, zero));
+        _mm512_storeu_si512(gray + x, _mm512_packus_epi16(lo, hi));
+    }
+    bgr_to_gray_row_avx2(bgr + 3 * x, gray + x, width - x);
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void threshold_row_avx512(const std::uint8_t* src, std::uint8_t* dst, int width,
+                          std::uint8_t thresh, std::uint8_t maxval) {
+    const __m512i t = _mm512_set1_epi8(static_cast<char>(thresh));
+    const __m512i m = _mm512_set1_epi8(static_cast<char>(maxval));
+    for (int x = 0; x < width; x += 64) {
+        // Masked load/store handles the row tail without a scalar loop
+        const int n = width - x < 64 ? width - x : 64;
+        const __mmask64 live = n == 64 ? ~__mmask64(0) : ((__mmask64(1) << n) - 1);
+        __m512i v = _mm512_maskz_loadu_epi8(live, src + x);
+        __mmask64 above = _mm512_cmpgt_epu8_mask(v, t);
+        _mm512_mask_storeu_epi8(dst + x, live, _mm512_maskz_mov_epi8(above, m));
+    }
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void column_sum_update_avx512(std::int32_t* sums, const std::uint8_t* add, const std::uint8_t* sub, int width) {
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m512i a = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(add + x)));
+        __m512i s = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sub + x)));
+        __m512i d = _mm512_sub_epi16(a, s);
+        _mm512_storeu_si512(sums + x, _mm512_add_epi32(_mm512_loadu_si512(sums + x),
+                                                       _mm512_cvtepi16_epi32(_mm512_castsi512_si256(d))));
+        _mm512_storeu_si512(sums + x + 16, _mm512_add_epi32(_mm512_loadu_si512(sums + x + 16),
+                                                            _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(d, 1))));
+    }
+    column_sum_update_avx2(sums + x, add + x, sub + x, width - x);
+}
+
+// Vertical 3-row min/max of the 64-byte block starting at column x.
+VISION_TARGET("avx512f,avx512bw")
+inline __m512i morph3_column_avx512(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* c,
+                                int x, bool dilate) {
+    __m512i va = _mm512_loadu_si512(a + x);
+    __m512i vb = _mm512_loadu_si512(b + x);
+    __m512i vc = _mm512_loadu_si512(c + x);
+    return dilate ? _mm512_max_epu8(_mm512_max_epu8(va, vb), vc) : _mm512_min_epu8(_mm512_min_epu8(va, vb), vc);
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void morph3_row_avx512(const std::uint8_t* above, const std::uint8_t* row, const std::uint8_t* below,
+                       std::uint8_t* dst, int width, bool dilate) {
+    const std::uint8_t* a = above ? above : row;
+    const std::uint8_t* c = below ? below : row;
+    if (width < 66) {
+        morph3_row_avx2(a, row, c, dst, width, dilate);
+        return;
+    }
+    dst[0] = morph3_at(a, row, c, 0, width, dilate);
+    int x = 1;
+    for (; x + 65 <= width; x += 64) {
+        __m512i l = morph3_column_avx512(a, row, c, x - 1, dilate);
+        __m512i m = morph3_column_avx512(a, row, c, x, dilate);
+        __m512i r = morph3_column_avx512(a, row, c, x + 1, dilate);
+        __m512i v = dilate ? _mm512_max_epu8(_mm512_max_epu8(l, m), r) : _mm512_min_epu8(_mm512_min_epu8(l, m), r);
+        _mm512_storeu_si512(dst + x, v);
+    }
+    for (; x < width; ++x) {
+        dst[x] = morph3_at(a, row, c, x, width, dilate);
+    }
+}
+
+VISION_TARGET("avx512f,avx512bw")
+inline __m512i binomial5_epi16_avx512(__m512i a, __m512i b, __m512i c, __m512i d, __m512i e) {
+    __m512i outer = _mm512_add_epi16(a, e);
+    __m512i inner = _mm512_slli_epi16(_mm512_add_epi16(b, d), 2);
+    __m512i center = _mm512_add_epi16(_mm512_slli_epi16(c, 2), _mm512_slli_epi16(c, 1));
+    return _mm512_add_epi16(_mm512_add_epi16(outer, inner), center);
+}
+
+VISION_TARGET("avx512f,avx512bw")
+inline __m512i load_epu8_epi16_avx512(const std::uint8_t* p) {
+    return _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void gaussian5_row_h_avx512(const std::uint8_t* src, std::uint16_t* dst, int width) {
+    if (width < 36) {
+        gaussian5_row_h_avx2(src, dst, width);
+        return;
+    }
+    dst[0] = gaussian5_at(src, 0, width);
+    dst[1] = gaussian5_at(src, 1, width);
+    int x = 2;
+    for (; x + 34 <= width; x += 32) {
+        __m512i v = binomial5_epi16_avx512(load_epu8_epi16_avx512(src + x - 2), load_epu8_epi16_avx512(src + x - 1),
+                                           load_epu8_epi16_avx512(src + x), load_epu8_epi16_avx512(src + x + 1),
+                                           load_epu8_epi16_avx512(src + x + 2));
+        _mm512_storeu_si512(dst + x, v);
+    }
+    for (; x < width; ++x) {
+        dst[x] = gaussian5_at(src, x, width);
+    }
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void gaussian5_row_v_avx512(const std::uint16_t* const* rows, std::uint8_t* dst, int width) {
+    const __m512i round = _mm512_set1_epi16(kGaussRound);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m512i r[5];
+        for (int k = 0; k < 5; ++k) {
+            r[k] = _mm512_loadu_si512(rows[k] + x);
+        }
+        __m512i sum = binomial5_epi16_avx512(r[0], r[1], r[2], r[3], r[4]);
+        __m512i v = _mm512_srli_epi16(_mm512_add_epi16(sum, round), kGaussShift);
+        // Results are at most 255, so truncating each lane to 8 bits is exact
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm512_cvtepi16_epi8(v));
+    }
+    gaussian5_row_v_avx2_from(rows, dst, x, width);
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void background_average_row_avx512(std::uint16_t* bg, const std::uint8_t* gray, int width, int rate) {
+    const __m512i r = _mm512_set1_epi16(static_cast<short>(rate << 8));
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m512i target = _mm512_slli_epi16(
+            _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(gray + x))), 8);
+        __m512i b = _mm512_loadu_si512(bg + x);
+        __m512i up = _mm512_mulhi_epu16(_mm512_subs_epu16(target, b), r);
+        __m512i down = _mm512_mulhi_epu16(_mm512_subs_epu16(b, target), r);
+        _mm512_storeu_si512(bg + x, _mm512_sub_epi16(_mm512_add_epi16(b, up), down));
+    }
+    background_average_row_avx2(bg + x, gray + x, width - x, rate);
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void background_median_row_avx512(std::uint16_t* bg, const std::uint8_t* gray, int width) {
+    const __m512i step = _mm512_set1_epi16(256);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m512i target = _mm512_slli_epi16(
+            _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(gray + x))), 8);
+        __m512i b = _mm512_loadu_si512(bg + x);
+        __m512i up = _mm512_min_epu16(_mm512_subs_epu16(target, b), step);
+        __m512i down = _mm512_min_epu16(_mm512_subs_epu16(b, target), step);
+        _mm512_storeu_si512(bg + x, _mm512_sub_epi16(_mm512_add_epi16(b, up), down));
+    }
+    background_median_row_avx2(bg + x, gray + x, width - x);
+}
+
+VISION_TARGET("avx512f,avx512bw")
+void background_diff_row_avx512(const std::uint16_t* bg, const std::uint8_t* gray, std::uint8_t* dst,
+                                int width, std::uint8_t thresh) {
+    const __m512i round = _mm512_set1_epi16(128);
+    const __m512i t = _mm512_set1_epi16(thresh);
+    const __m512i ones = _mm512_set1_epi16(255);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m512i level = _mm512_srli_epi16(_mm512_add_epi16(_mm512_loadu_si512(bg + x), round), 8);
+        __m512i g = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(gray + x)));
+        __mmask32 above = _mm512_cmpgt_epi16_mask(_mm512_abs_epi16(_mm512_sub_epi16(g, level)), t);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                            _mm512_cvtepi16_epi8(_mm512_maskz_mov_epi16(above, ones)));
+    }
+    background_diff_row_avx2(bg + x, gray + x, dst + x, width - x, thresh);
+}
+
+#endif // VISION_X86
+
+const VisionKernels kScalarKernels = {
+    CpuIsa::Scalar, bgr_to_gray_row_scalar, threshold_row_scalar,
+    column_sum_update_scalar, morph3_row_scalar,
+    gaussian5_row_h_scalar, gaussian5_row_v_scalar,
+    background_average_row_scalar, background_median_row_scalar, background_diff_row_scalar};
+
+#if VISION_X86
+const VisionKernels kSSE42Kernels = {
+    CpuIsa::SSE42, bgr_to_gray_row_sse42, threshold_row_sse42,
+    column_sum_update_sse42, morph3_row_sse42,
+    gaussian5_row_h_sse42, gaussian5_row_v_sse42,
+    background_average_row_sse42, background_median_row_sse42, background_diff_row_sse42};
+const VisionKernels kAVX2Kernels = {
+    CpuIsa::AVX2, bgr_to_gray_row_avx2, threshold_row_avx2,
+    column_sum_update_avx2, morph3_row_avx2,
+    gaussian5_row_h_avx2, gaussian5_row_v_avx2,
+    background_average_row_avx2, background_median_row_avx2, background_diff_row_avx2};
+const VisionKernels kAVX512Kernels = {
+    CpuIsa::AVX512, bgr_to_gray_row_avx512, threshold_row_avx512,
+    column_sum_update_avx512, morph3_row_avx512,
+    gaussian5_row_h_avx512, gaussian5_row_v_avx512,
+    background_average_row_avx512, background_median_row_avx512, background_diff_row_avx512};
+#endif
+
+// Parses the VISION_ISA override; anything unrecognised means "no override".
+bool parse_isa_override(CpuIsa& isa) {
+    const char* value = std::getenv("VISION_ISA");
+    if (value == nullptr) return false;
+    std::string name(value);
+    if (name == "scalar") isa = CpuIsa::Scalar;
+    else if (name == "sse4.2" || name == "sse42") isa = CpuIsa::SSE42;
+    else if (name == "avx2") isa = CpuIsa::AVX2;
+    else if (name == "avx512") isa = CpuIsa::AVX512;
+    else return false;
+    return true;
+}
+
+} // namespace
+
+CpuIsa detect_cpu_isa() {
+#if VISION_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return CpuIsa::AVX512;
+    if (__builtin_cpu_supports("avx2")) return CpuIsa::AVX2;
+    if (__builtin_cpu_supports("sse4.2")) return CpuIsa::SSE42;
+#endif
+    return CpuIsa::Scalar;
+}
+
+const char* cpu_isa_name(CpuIsa isa) {
+    switch (isa) {
+        case CpuIsa::SSE42: return "sse4.2";
+        case CpuIsa::AVX2: return "avx2";
+        case CpuIsa::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+const VisionKernels& vision_kernels_for(CpuIsa isa) {
+    CpuIsa supported = detect_cpu_isa();
+    if (isa > supported) isa = supported;
+#if VISION_X86
+    switch (isa) {
+        case CpuIsa::AVX512: return kAVX512Kernels;
+        case CpuIsa::AVX2: return kAVX2Kernels;
+        case CpuIsa::SSE42: return kSSE42Kernels;
+        default: break;
+    }
+#endif
+    return kScalarKernels;
+}
+
+const VisionKernels& vision_kernels() {
+    static const VisionKernels& selected = [] () -> const VisionKernels& {
+        CpuIsa isa = detect_cpu_isa();
+        parse_isa_override(isa);
+        return vision_kernels_for(isa);
+    }();
+    return selected;
+}
@@ -0,0 +1,78 @@
+/*
+Author: Carolina Li
+Date: Oct/17/2026
+File: vision_kernels.h
+Purpose: Declares the hot per-row pixel kernels used by the vision core. Each kernel
+is compiled for several x86 ISA levels (SSE4.2, AVX2, AVX-512) plus a portable scalar
+fallback, and the best variant for the running CPU is picked once at startup via cpuid.
+This header has no OpenCV dependency so the kernels can be built and checked on their own.
+*/
+
+#ifndef VISION_KERNELS_H
+#define VISION_KERNELS_H
+
+#include <cstdint>
+
+// Instruction set levels the kernels are compiled for, from slowest to fastest.
+enum class CpuIsa {
+    Scalar,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+// Table of row kernels resolved for one ISA level.
+struct VisionKernels {
+    CpuIsa isa;
+
+    // Converts `width` interleaved BGR pixels to 8-bit gray, bit-exact with cv::COLOR_BGR2GRAY.
+    void (*bgr_to_gray_row)(const std::uint8_t* bgr, std::uint8_t* gray, int width);
+
+    // Writes maxval where src > thresh and 0 elsewhere (cv::THRESH_BINARY semantics).
+    void (*threshold_row)(const std::uint8_t* src, std::uint8_t* dst, int width,
+                          std::uint8_t thresh, std::uint8_t maxval);
+
+    // Sliding-window column sums: sums[x] += add[x] - sub[x]. Used by the O(1) box filters.
+    void (*column_sum_update)(std::int32_t* sums, const std::uint8_t* add, const std::uint8_t* sub, int width);
+
+    // One row of a 3x3 rectangular dilation (dilate = true, max) or erosion (min).
+    // above/below may be null at the image edge; pixels outside the image are ignored,
+    // matching cv::morphologyEx's default border.
+    void (*morph3_row)(const std::uint8_t* above, const std::uint8_t* row, const std::uint8_t* below,
+                       std::uint8_t* dst, int width, bool dilate);
+
+    // Horizontal pass of the 5x5 binomial Gaussian: dst[x] = 1-4-6-4-1 weighted sum of src
+    // around x, unnormalized (at most 16 * 255), with cv::BORDER_REFLECT_101 at the row ends.
+    void (*gaussian5_row_h)(const std::uint8_t* src, std::uint16_t* dst, int width);
+
+    // Vertical pass: combines five horizontal-sum rows, top to bottom, into one 8-bit row as
+    // (1-4-6-4-1 sum + 128) >> 8. Bit-exact with 8-bit cv::GaussianBlur(Size(5, 5), 0).
+    void (*gaussian5_row_v)(const std::uint16_t* const* rows, std::uint8_t* dst, int width);
+
+    // Background models keep gray levels in 8.8 fixed point. Exponential average:
+    // bg += (gray * 256 - bg) * rate / 256, with rate in [1, 255] (alpha = rate / 256).
+    void (*background_average_row)(std::uint16_t* bg, const std::uint8_t* gray, int width, int rate);
+
+    // Approximate running median: bg moves one gray level towards gray, which converges to
+    // the per-pixel temporal median without keeping a history.
+    void (*background_median_row)(std::uint16_t* bg, const std::uint8_t* gray, int width);
+
+    // Writes 255 where |gray - round(bg / 256)| > thresh and 0 elsewhere.
+    void (*background_diff_row)(const std::uint16_t* bg, const std::uint8_t* gray, std::uint8_t* dst,
+                                int width, std::uint8_t thresh);
+};
+
+// Returns the highest ISA level supported by both this build and the running CPU.
+CpuIsa detect_cpu_isa();
+
+// Returns a short printable name for an ISA level ("scalar", "sse4.2", "avx2", "avx512").
+const char* cpu_isa_name(CpuIsa isa);
+
+// Returns the kernel table for a specific ISA level, clamped to what the CPU supports.
+const VisionKernels& vision_kernels_for(CpuIsa isa);
+
+// Returns the kernel table selected at startup. The environment variable VISION_ISA
+// (scalar, sse4.2, avx2, avx512) can lower the choice for testing and benchmarking.
+const VisionKernels& vision_kernels();
+
+#endif // VISION_KERNELS_H